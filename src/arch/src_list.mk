@@ -26,6 +26,7 @@ SRC += $(SRC_DIR)/arch/$(TARGET_ARCH)/task/tss.c
 SRC += $(SRC_DIR)/arch/$(TARGET_ARCH)/task/task.c
 SRC += $(SRC_DIR)/arch/$(TARGET_ARCH)/task/schedule.c
 SRC += $(SRC_DIR)/arch/$(TARGET_ARCH)/task/asm_schedule.S
+SRC += $(SRC_DIR)/arch/$(TARGET_ARCH)/task/fpu.c
 SRC += $(SRC_DIR)/arch/$(TARGET_ARCH)/task/proc.c
 SRC += $(SRC_DIR)/arch/$(TARGET_ARCH)/task/asm_proc.S
 SRC += $(SRC_DIR)/arch/$(TARGET_ARCH)/sync/atomic.c
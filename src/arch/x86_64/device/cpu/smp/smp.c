@@ -43,6 +43,33 @@ PRIVATE void ipi_panic_handler(intr_stack_t *stack)
     return;
 }
 
+PRIVATE void ipi_reschedule_handler(intr_stack_t *stack)
+{
+    send_eoi(stack->int_vector);
+    // 中断返回前进行调度
+    get_task_man(running_task()->cpu_id)->need_resched = TRUE;
+    return;
+}
+
+PUBLIC void smp_send_reschedule(uint32_t cpu_id)
+{
+    uint64_t icr = make_icr(
+        0x83,
+        ICR_DELIVER_MODE_FIXED,
+        ICR_DEST_MODE_PHY,
+        ICR_DELIVER_STATUS_IDLE,
+        ICR_LEVEL_DE_ASSEST,
+        ICR_TRIGGER_EDGE,
+        ICR_NO_SHORTHAND,
+        cpu_id
+    );
+    // ICR需分两次写入,写入期间不能被中断打断
+    intr_status_t intr_status = intr_disable();
+    send_ipi(icr);
+    intr_set_status(intr_status);
+    return;
+}
+
 PUBLIC status_t smp_init(void)
 {
     // copy ap_boot
@@ -86,12 +113,15 @@ PUBLIC status_t smp_init(void)
             ap_main_task, name, DEFAULT_PRIORITY, kstack_base, KERNEL_STACK_SIZE
         );
         ap_main_task->cpu_id = i;
+        memset(&ap_main_task->cpus_allowed, 0, sizeof(cpumask_t));
+        CPUMASK_SET(&ap_main_task->cpus_allowed, i);
         task_man_t *task_man = get_task_man(i);
         task_man->main_task  = ap_main_task;
     }
 
     // register IPI
     register_handle(0x81, ipi_panic_handler);
+    register_handle(0x83, ipi_reschedule_handler);
 
     // init IPI
     uint64_t icr = make_icr(
@@ -11,12 +11,12 @@
 #include <device/pic.h>   // eoi
 #include <device/timer.h> // COUNTER0_VALUE_LO,COUNTER0_VALUE_HI,IRQ0_FREQUENCY
 #include <intr.h>         // register_handle
-#include <io.h>           // io_out8
+#include <io.h>           // io_out8,read_tsc
 #include <kernel/syscall.h> // inform_intr
 #include <mem/page.h>       // PHYS_TO_VIRT
 #include <service.h>        // TICK
 #include <softirq.h>        // register_softirq,rasie_softirq
-#include <task/task.h>      // do_schedule
+#include <task/task.h>      // task_update,running_task,spinlock
 
 // HPET
 #define HPET_DEFAULT_ADDRESS 0xfed00000
@@ -33,8 +33,18 @@
 #define COUNTER0_VALUE_LO ((INPUT_FREQUENCY / IRQ0_FREQUENCY) & 0xff)
 #define COUNTER0_VALUE_HI (((INPUT_FREQUENCY / IRQ0_FREQUENCY) >> 8) & 0xff)
 
+// APIC定时器LVT: 向量0x80,单次模式/周期模式
+#define APIC_TIMER_ONESHOT  0x80
+#define APIC_TIMER_PERIODIC (0x80 | 0x20000)
+
+// NO_HZ空闲状态下最长的休眠时间,空闲cpu至少每隔这段时间醒来一次进行负载均衡
+#define NOHZ_MAX_IDLE_TICKS MS_TO_TICKS(50)
+
 PRIVATE volatile uint64_t current_ticks = 0;
 
+// TSC周期数到纳秒的换算系数: ns = (tsc * tsc_mult) >> 32
+PRIVATE uint64_t tsc_mult = 0;
+
 typedef struct
 {
     uint8_t  *addr;
@@ -48,6 +58,111 @@ typedef struct
 
 PRIVATE hpet_t hpet = { 0 };
 
+// 每个cpu的定时器队列与APIC定时器状态
+typedef struct timer_queue_s
+{
+    rbtree_t          tree; // 按到期时刻排序,缓存了最早到期的定时器
+    spinlock_t        lock; // 可能在中断中获取,持有时需关闭中断
+    timer_t *volatile running; // 正在执行回调函数的定时器
+
+    uint32_t apic_period;  // 一个tick对应的APIC定时器计数
+    bool     tick_stopped; // 周期性时钟已停止(处于NO_HZ空闲状态)
+} timer_queue_t;
+
+PRIVATE timer_queue_t timer_queues[NR_CPUS];
+
+PRIVATE bool timer_less(rbtree_node_t *a, rbtree_node_t *b)
+{
+    timer_t *timer_a = CONTAINER_OF(timer_t, node, a);
+    timer_t *timer_b = CONTAINER_OF(timer_t, node, b);
+    return (int64_t)(timer_a->expires - timer_b->expires) < 0;
+}
+
+PUBLIC void init_timer(timer_t *timer, void (*func)(timer_t *timer))
+{
+    timer->expires = 0;
+    timer->cpu_id  = 0;
+    timer->pending = FALSE;
+    timer->func    = func;
+    return;
+}
+
+PUBLIC void timer_add(timer_t *timer, uint64_t expires)
+{
+    ASSERT(!timer->pending);
+    intr_status_t  intr_status = intr_disable();
+    uint32_t       cpu_id      = running_task()->cpu_id;
+    timer_queue_t *queue       = &timer_queues[cpu_id];
+
+    spinlock_lock(&queue->lock);
+    timer->expires = expires;
+    timer->cpu_id  = cpu_id;
+    timer->pending = TRUE;
+    rbtree_insert(&queue->tree, &timer->node, timer_less);
+    spinlock_unlock(&queue->lock);
+
+    intr_set_status(intr_status);
+    return;
+}
+
+PUBLIC bool timer_del(timer_t *timer)
+{
+    intr_status_t  intr_status = intr_disable();
+    timer_queue_t *queue       = &timer_queues[timer->cpu_id];
+    bool           pending     = FALSE;
+
+    spinlock_lock(&queue->lock);
+    if (timer->pending)
+    {
+        rbtree_remove(&queue->tree, &timer->node);
+        timer->pending = FALSE;
+        pending        = TRUE;
+    }
+    spinlock_unlock(&queue->lock);
+
+    // 等待正在执行的回调函数结束
+    while (queue->running == timer) continue;
+
+    intr_set_status(intr_status);
+    return pending;
+}
+
+/**
+ * @brief 执行当前cpu上所有已到期的定时器
+ * @note 在时钟中断中调用
+ */
+PRIVATE void run_timers(void)
+{
+    timer_queue_t *queue = &timer_queues[running_task()->cpu_id];
+    if (rbtree_empty(&queue->tree))
+    {
+        return;
+    }
+
+    uint64_t       now = current_ticks;
+    rbtree_node_t *node;
+    spinlock_lock(&queue->lock);
+    while ((node = rbtree_first(&queue->tree)) != NULL)
+    {
+        timer_t *timer = CONTAINER_OF(timer_t, node, node);
+        if ((int64_t)(timer->expires - now) > 0)
+        {
+            break;
+        }
+        rbtree_remove(&queue->tree, node);
+        timer->pending = FALSE;
+        queue->running = timer;
+        spinlock_unlock(&queue->lock);
+
+        timer->func(timer);
+
+        queue->running = NULL;
+        spinlock_lock(&queue->lock);
+    }
+    spinlock_unlock(&queue->lock);
+    return;
+}
+
 PRIVATE void timer_handler(intr_stack_t *stack)
 {
     send_eoi(stack->int_vector);
@@ -66,6 +181,7 @@ PRIVATE void timer_softirq(void *data)
 PRIVATE void apic_timer_handler(intr_stack_t *stack)
 {
     send_eoi(stack->int_vector);
+    run_timers();
     task_update();
     return;
 }
@@ -108,6 +224,15 @@ PRIVATE void init_8254pit(void)
 PUBLIC void pit_init(void)
 {
     current_ticks = 0;
+    int i;
+    for (i = 0; i < NR_CPUS; i++)
+    {
+        init_rbtree(&timer_queues[i].tree);
+        init_spinlock(&timer_queues[i].lock);
+        timer_queues[i].running      = NULL;
+        timer_queues[i].apic_period  = 0;
+        timer_queues[i].tick_stopped = FALSE;
+    }
     register_handle(0x20, timer_handler);
     register_handle(0x80, apic_timer_handler);
     register_softirq(SOFTIRQ_TIMER, timer_softirq, NULL);
@@ -128,26 +253,91 @@ PUBLIC void apic_timer_init()
     local_apic_write(APIC_REG_TIMER_ICNT, 0xffffffff);
     uint32_t          apic_ticks = 0;
     volatile uint32_t ticks      = get_current_ticks() + MS_TO_TICKS(10);
+    uint64_t          tsc_start  = read_tsc();
+    uint64_t          ns_start   = get_nano_time();
     while (ticks >= get_current_ticks()) continue;
 
     // Stop APIC timer
     local_apic_write(APIC_REG_LVT_TIMER, 0x10000);
     apic_ticks = -local_apic_read(APIC_REG_TIMER_CCNT);
 
+    // 各cpu的TSC频率相同,只在第一次(BSP)校准
+    if (tsc_mult == 0)
+    {
+        uint64_t tsc = read_tsc() - tsc_start;
+        uint64_t ns  = get_nano_time() - ns_start;
+        tsc_mult     = (ns << 32) / tsc;
+    }
+
     // 1000 Hz
     apic_ticks /= 10;
 
-    local_apic_write(APIC_REG_LVT_TIMER, 0x80 | 0x20000);
+    timer_queue_t *queue = &timer_queues[running_task()->cpu_id];
+    queue->apic_period   = apic_ticks;
+    queue->tick_stopped  = FALSE;
+
+    local_apic_write(APIC_REG_LVT_TIMER, APIC_TIMER_PERIODIC);
     local_apic_write(APIC_REG_TIMER_DIV, 0x00000003);
     local_apic_write(APIC_REG_TIMER_ICNT, apic_ticks);
     return;
 }
 
+PUBLIC void tick_nohz_idle_enter(void)
+{
+    ASSERT(intr_get_status() == INTR_OFF);
+    timer_queue_t *queue = &timer_queues[running_task()->cpu_id];
+    uint64_t       delta = NOHZ_MAX_IDLE_TICKS;
+
+    // APIC定时器尚未初始化
+    if (queue->apic_period == 0)
+    {
+        return;
+    }
+
+    spinlock_lock(&queue->lock);
+    rbtree_node_t *node = rbtree_first(&queue->tree);
+    if (node != NULL)
+    {
+        timer_t *timer = CONTAINER_OF(timer_t, node, node);
+        int64_t  left  = (int64_t)(timer->expires - current_ticks);
+        if (left < (int64_t)delta)
+        {
+            delta = left > 0 ? (uint64_t)left : 1;
+        }
+    }
+    spinlock_unlock(&queue->lock);
+
+    // 切换到单次模式,在下一个定时器到期时产生一次中断
+    queue->tick_stopped = TRUE;
+    local_apic_write(APIC_REG_LVT_TIMER, APIC_TIMER_ONESHOT);
+    local_apic_write(APIC_REG_TIMER_ICNT, delta * queue->apic_period);
+    return;
+}
+
+PUBLIC void tick_nohz_idle_exit(void)
+{
+    ASSERT(intr_get_status() == INTR_OFF);
+    timer_queue_t *queue = &timer_queues[running_task()->cpu_id];
+    if (!queue->tick_stopped)
+    {
+        return;
+    }
+    queue->tick_stopped = FALSE;
+    local_apic_write(APIC_REG_LVT_TIMER, APIC_TIMER_PERIODIC);
+    local_apic_write(APIC_REG_TIMER_ICNT, queue->apic_period);
+    return;
+}
+
 PUBLIC uint64_t get_current_ticks(void)
 {
     return current_ticks;
 }
 
+PUBLIC uint64_t tsc_to_ns(uint64_t tsc)
+{
+    return (uint64_t)(((unsigned __int128)tsc * tsc_mult) >> 32);
+}
+
 PUBLIC uint64_t get_nano_time(void)
 {
     if (hpet.period_fs != 0)
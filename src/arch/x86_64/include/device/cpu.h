@@ -25,6 +25,19 @@
 
 #ifndef __ASM_INCLUDE__
 
+#    define CPUMASK_WORDS (NR_CPUS / 64)
+
+// cpu位图,第n位对应cpu_id为n的cpu
+typedef struct cpumask_s
+{
+    uint64_t bits[CPUMASK_WORDS];
+} cpumask_t;
+
+#    define CPUMASK_TEST(MASK, CPU) \
+        ((((MASK)->bits[(CPU) / 64]) >> ((CPU) % 64)) & 1)
+#    define CPUMASK_SET(MASK, CPU) \
+        ((MASK)->bits[(CPU) / 64] |= 1ULL << ((CPU) % 64))
+
 extern uint64_t rdmsr(uint64_t address);
 extern void     wrmsr(uint64_t address, uint64_t value);
 
@@ -57,6 +70,12 @@ PUBLIC status_t smp_init(void);
 PUBLIC status_t smp_start(void);
 PUBLIC void     send_ipi(uint64_t icr);
 
+/**
+ * @brief 向cpu发送调度IPI,使其在中断返回前进行调度(包括处于hlt状态的cpu)
+ * @param cpu_id 目标cpu
+ */
+PUBLIC void smp_send_reschedule(uint32_t cpu_id);
+
 extern uint8_t AP_BOOT_BASE[];
 extern uint8_t AP_BOOT_END[];
 
@@ -15,4 +15,8 @@ extern void     sse_init(void);
 extern void ASMLINKAGE asm_fxsave(fxsave_region_t *fxsave_region);
 extern void ASMLINKAGE asm_fxrstor(fxsave_region_t *fxsave_region);
 
+// 清除/设置CR0.TS
+extern void ASMLINKAGE asm_clts(void);
+extern void ASMLINKAGE asm_stts(void);
+
 #endif
\ No newline at end of file
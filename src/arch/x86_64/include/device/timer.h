@@ -6,6 +6,8 @@
 #ifndef __TIMER_H__
 #define __TIMER_H__
 
+#include <lib/rbtree.h>
+
 #define IRQ0_FREQUENCY 1000UL
 
 #define MS_TO_TICKS(MS) ((MS) * 1000 / IRQ0_FREQUENCY)
@@ -16,9 +18,64 @@
 #define TICKS_TO_US(TICKS) ((TICK) * 1000000 / IRQ0_FREQUENCY)
 #define TICKS_TO_NS(TICKS) ((TICK) * 1000000000 / IRQ0_FREQUENCY)
 
+typedef struct timer_s timer_t;
+
+struct timer_s
+{
+    rbtree_node_t node;
+    uint64_t      expires; // 到期时刻(ticks)
+    uint32_t      cpu_id;  // 定时器所在的cpu
+    bool          pending; // 定时器是否在队列中
+
+    // 到期时在定时器所在cpu的时钟中断中调用(中断已关闭)
+    void (*func)(timer_t *timer);
+};
+
+/**
+ * @brief 初始化定时器
+ * @param timer 定时器
+ * @param func 到期时调用的函数
+ */
+PUBLIC void init_timer(timer_t *timer, void (*func)(timer_t *timer));
+
+/**
+ * @brief 将定时器加入当前cpu的定时器队列
+ * @param timer 定时器(不能已在队列中)
+ * @param expires 到期时刻(ticks)
+ */
+PUBLIC void timer_add(timer_t *timer, uint64_t expires);
+
+/**
+ * @brief 将定时器从队列中删除
+ * @param timer 定时器
+ * @return 定时器删除前仍在队列中(尚未到期)时返回TRUE
+ * @note 若定时器的回调函数正在执行,将等待其执行完毕,
+ *       因此不能在回调函数中删除定时器自身
+ */
+PUBLIC bool timer_del(timer_t *timer);
+
 PUBLIC void     pit_init(void);
 PUBLIC void     apic_timer_init(void);
 PUBLIC uint64_t get_current_ticks(void);
 PUBLIC uint64_t get_nano_time(void);
 
+/**
+ * @brief 将TSC周期数换算为纳秒
+ * @param tsc TSC周期数
+ * @note 在BSP的apic_timer_init()完成校准前返回0
+ */
+PUBLIC uint64_t tsc_to_ns(uint64_t tsc);
+
+/**
+ * @brief 停止当前cpu的周期性时钟,改为在下一个定时器到期时产生单次中断
+ * @note 由idle任务在关闭中断后,执行hlt前调用
+ */
+PUBLIC void tick_nohz_idle_enter(void);
+
+/**
+ * @brief 恢复当前cpu的周期性时钟
+ * @note 需关闭中断,周期性时钟未停止时不做任何操作
+ */
+PUBLIC void tick_nohz_idle_exit(void);
+
 #endif
\ No newline at end of file
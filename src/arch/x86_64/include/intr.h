@@ -52,6 +52,7 @@ typedef enum intr_status_e
 
 PUBLIC void            default_irq_handler(intr_stack_t *stack);
 PUBLIC void ASMLINKAGE do_irq(intr_stack_t *stack);
+PUBLIC void ASMLINKAGE do_irq_exit(intr_stack_t *stack);
 PUBLIC void            intr_init(void);
 PUBLIC void            ap_intr_init(void);
 PUBLIC void register_handle(uint8_t int_vector, void (*handle)(intr_stack_t *));
@@ -206,7 +207,7 @@ INTR_HANDLER(asm_intr0x7f_handler, 0x7f, ZERO)
 INTR_HANDLER(asm_intr0x80_handler, 0x80, ZERO) // Timer
 INTR_HANDLER(asm_intr0x81_handler, 0x81, ZERO) // Kernel panic
 INTR_HANDLER(asm_intr0x82_handler, 0x82, ZERO) // debug
-INTR_HANDLER(asm_intr0x83_handler, 0x83, ZERO)
+INTR_HANDLER(asm_intr0x83_handler, 0x83, ZERO) // Reschedule
 INTR_HANDLER(asm_intr0x84_handler, 0x84, ZERO)
 INTR_HANDLER(asm_intr0x85_handler, 0x85, ZERO)
 INTR_HANDLER(asm_intr0x86_handler, 0x86, ZERO)
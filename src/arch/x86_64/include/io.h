@@ -12,6 +12,8 @@ extern void io_hlt(void);
 extern void io_stihlt(void);
 extern void io_mfence(void);
 
+extern uint64_t read_tsc(void);
+
 extern uint32_t io_in8(uint32_t port);
 extern uint32_t io_in16(uint32_t port);
 extern uint32_t io_in32(uint32_t port);
@@ -25,5 +27,8 @@ extern uint64_t get_rsp();
 extern uint64_t get_cr2();
 extern uint64_t get_cr3();
 extern void     set_cr3(uint64_t cr3);
+extern uint64_t get_cr4();
+extern void     set_cr4(uint64_t cr4);
+extern void     invlpg(void *vaddr);
 
 #endif
\ No newline at end of file
@@ -38,6 +38,9 @@ typedef int bool;
 #define WEAK           __attribute__((weak))
 #define ALIGNED(ALIGN) __attribute__((aligned(ALIGN)))
 
+// cpu缓存行的大小(字节)
+#define CACHE_LINE_SIZE 64
+
 #ifndef STATIC_ASSERT
 #    define STATIC_ASSERT(CONDITION, MESSAGE) _Static_assert(CONDITION, MESSAGE)
 #endif
@@ -8,11 +8,15 @@
 
 #define FUNC_SEND (1 << 0)
 #define FUNC_RECV (1 << 1)
+#define FUNC_REG   (1 << 2) // 短消息: 类型与m[0] ~ m[5]通过寄存器传递
+#define FUNC_ASYNC (1 << 3) // 异步发送: 消息放入接收者的邮箱后立即返回
 
 #define NR_SEND (0x80000000 | FUNC_SEND)
 #define NR_RECV (0x80000000 | FUNC_RECV)
 #define NR_BOTH (0x80000000 | FUNC_SEND | FUNC_RECV)
 
+#define NR_SEND_ASYNC (NR_SEND | FUNC_ASYNC)
+
 #define SEND_TO_KERNEL -1
 #define RECV_FROM_INT  -2
 #define RECV_FROM_ANY  -3
@@ -23,6 +27,20 @@
 #define SYSCALL_DEADLOCK       3
 #define SYSCALL_DEST_NOT_EXIST 4
 #define SYSCALL_SRC_NOT_EXIST  5
+#define SYSCALL_MAILBOX_FULL   6
+
+// message_t的大小,短消息在内核栈上构造message_t时使用
+#define MESSAGE_SIZE 72
+
+// 短消息通过寄存器传递的数据个数
+#define REG_MESSAGE_WORDS 6
+
+// 每个任务的异步消息邮箱的容量(2的幂)
+#define MAILBOX_SIZE 16
+
+#ifndef __ASM_INCLUDE__
+
+#    include <sync/atomic.h> // atomic_t
 
 typedef struct message_s
 {
@@ -31,6 +49,23 @@ typedef struct message_s
     uint64_t          m[8];
 } message_t;
 
+typedef struct mailbox_slot_s
+{
+    atomic_t  seq; // 等于写入位置时可写入,等于写入位置 + 1时可读出
+    message_t msg;
+} mailbox_slot_t;
+
+// 异步消息邮箱: 多个发送者无锁写入,只由所属任务读出的环形队列
+typedef struct mailbox_s
+{
+    // 下一个写入位置(由发送者竞争)
+    atomic_t tail;
+    // 下一个读出位置(只由接收者修改),与tail位于不同的缓存行
+    uint64_t       head ALIGNED(CACHE_LINE_SIZE);
+    bool           turn; // 同步与异步消息都可接收时是否轮到邮箱(只由接收者修改)
+    mailbox_slot_t slots[MAILBOX_SIZE];
+} mailbox_t;
+
 typedef uint32_t syscall_status_t;
 
 PUBLIC void syscall_init(void);
@@ -38,6 +73,32 @@ PUBLIC void syscall_init(void);
 PUBLIC syscall_status_t ASMLINKAGE
 send_recv(uint32_t function, pid_t src_dst, void *msg);
 
+/**
+ * @brief 以寄存器传递消息的send_recv,不在用户内存中构造message_t
+ * @param function NR_SEND,NR_RECV或NR_BOTH
+ * @param src_dst 消息的目的地或来源
+ * @param type 消息类型
+ * @param m0 ~ m5 消息的m[0] ~ m[5],不使用的数据传0
+ * @param out 非NULL时存储收到的m[0] ~ m[REG_MESSAGE_WORDS - 1]
+ * @return
+ * @note 寄存器约定: edi = function | FUNC_REG, esi = src_dst, edx = type,
+ *       r10,r8,r9,rbx,r12,r13 = m[0] ~ m[5].
+ *       返回时eax为状态,esi为消息来源,其余寄存器为收到的消息.
+ *       内核在内核栈上构造message_t,不读写用户内存中的消息
+ */
+PUBLIC syscall_status_t ASMLINKAGE send_recv_reg(
+    uint32_t  function,
+    pid_t     src_dst,
+    uint32_t  type,
+    uint64_t  m0,
+    uint64_t  m1,
+    uint64_t  m2,
+    uint64_t  m3,
+    uint64_t  m4,
+    uint64_t  m5,
+    uint64_t *out
+);
+
 PUBLIC syscall_status_t ASMLINKAGE
 sys_send_recv(uint32_t function, pid_t src_dst, message_t *msg);
 
@@ -49,13 +110,33 @@ sys_send_recv(uint32_t function, pid_t src_dst, message_t *msg);
 PUBLIC void inform_intr(pid_t dst);
 
 PUBLIC syscall_status_t msg_send(pid_t dst, message_t *msg);
+
+/**
+ * @brief 将消息放入dst的邮箱后立即返回
+ * @param dst 目标任务
+ * @param msg 消息
+ * @return 邮箱已满时返回SYSCALL_MAILBOX_FULL
+ * @note 邮箱中的消息由RECV_FROM_ANY或从当前任务接收的msg_recv取出,
+ *       同步与异步消息都有时RECV_FROM_ANY交替接收两者
+ */
+PUBLIC syscall_status_t msg_send_async(pid_t dst, message_t *msg);
+
+/**
+ * @brief 初始化异步消息邮箱
+ * @param mailbox 邮箱
+ */
+PUBLIC void mailbox_init(mailbox_t *mailbox);
 PUBLIC syscall_status_t msg_recv(pid_t src, message_t *msg);
 
 /**
- * @brief 检查task的ipc状态
- * @param pid
+ * @brief 向dst发送消息后等待dst的回复
+ * @param dst 目标任务
+ * @param msg 发送的消息,回复也存入其中
  * @return
+ * @note dst已在等待消息时,消息直接复制到dst的缓冲区,并直接切换到dst
  */
-PUBLIC int task_ipc_check(pid_t pid);
+PUBLIC syscall_status_t msg_send_recv(pid_t dst, message_t *msg);
+
+#endif /* __ASM_INCLUDE__ */
 
 #endif
\ No newline at end of file
@@ -23,6 +23,7 @@
 // Page Chace Disable
 #define PG_PCD           (1 << 4)
 #define PG_SIZE_2M       (1 << 7)
+#define PG_G             (1 << 8) // Global
 #define PG_DEFAULT_FLAGS (PG_US_U | PG_RW_W | PG_P | PG_SIZE_2M)
 
 #define ADDR_PML4T_INDEX_SHIFT 39
@@ -50,6 +51,7 @@
 #ifndef __ASM_INCLUDE__
 
 PUBLIC void   mem_page_init(void);
+PUBLIC void   page_global_init(void);
 PUBLIC size_t get_total_free_pages(void);
 
 /**
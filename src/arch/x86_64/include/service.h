@@ -22,6 +22,7 @@ typedef struct service_task_s service_task_t;
 
 PUBLIC bool  is_service_id(uint32_t sid);
 PUBLIC pid_t service_id_to_pid(uint32_t sid);
+PUBLIC bool  is_service_pid(pid_t pid);
 PUBLIC void  service_init(void);
 
 
@@ -32,16 +33,36 @@ PUBLIC void keyboard_main(void);
 // Kernel services                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
-#define KERN_EXIT          0
-#define KERN_GET_PID       1
-#define KERN_GET_PPID      2
-#define KERN_CREATE_PROC   3
-#define KERN_WAITPID       4
-#define KERN_ALLOCATE_PAGE 5
-#define KERN_FREE_PAGE     6
-#define KERN_READ_TASK_MEM 7
-
-#define KERN_SYSCALLS 8
+#define KERN_EXIT             0
+#define KERN_GET_PID          1
+#define KERN_GET_PPID         2
+#define KERN_CREATE_PROC      3
+#define KERN_WAITPID          4
+#define KERN_ALLOCATE_PAGE    5
+#define KERN_FREE_PAGE        6
+#define KERN_READ_TASK_MEM    7
+#define KERN_GET_FPU_STAT     8
+#define KERN_GET_TASK_TIME    9
+#define KERN_SET_SCHED        10
+#define KERN_SET_SLICE        11
+#define KERN_SET_AFFINITY     12
+#define KERN_GET_AFFINITY     13
+#define KERN_GET_SCHED_AVG    14
+#define KERN_CREATE_GROUP     15
+#define KERN_SET_GROUP_WEIGHT 16
+#define KERN_SET_GROUP        17
+#define KERN_GET_GROUP        18
+#define KERN_SET_DEADLINE     19
+#define KERN_GET_TASK_STAT    20
+#define KERN_GET_CPU_STAT     21
+#define KERN_SHM_CREATE       22
+#define KERN_SHM_GRANT        23
+#define KERN_SHM_MAP          24
+#define KERN_SHM_UNMAP        25
+#define KERN_RING_SETUP       26
+#define KERN_RING_ENTER       27
+
+#define KERN_SYSCALLS 28
 
 // exit
 #define IN_KERN_EXIT_STATUS 0
@@ -80,8 +101,224 @@ PUBLIC void keyboard_main(void);
 #define IN_KERN_READ_TASK_MEM_SIZE   2
 #define IN_KERN_READ_TASK_MEM_BUFFER 3
 
+// get fpu stat
+#define IN_KERN_GET_FPU_STAT_CPU 0
+
+#define OUT_KERN_GET_FPU_STAT_SWITCHES 0
+#define OUT_KERN_GET_FPU_STAT_SAVES    1
+#define OUT_KERN_GET_FPU_STAT_RESTORES 2
+
+// get task time
+#define IN_KERN_GET_TASK_TIME_PID 0
+
+#define OUT_KERN_GET_TASK_TIME_USER   0
+#define OUT_KERN_GET_TASK_TIME_KERNEL 1
+#define OUT_KERN_GET_TASK_TIME_WAIT   2
+
+// set sched
+#define IN_KERN_SET_SCHED_PID         0
+#define IN_KERN_SET_SCHED_POLICY      1
+#define IN_KERN_SET_SCHED_RT_PRIORITY 2
+
+// IN_KERN_SET_SCHED_POLICY
+#define SCHED_NORMAL   0 // 普通任务(CFS)
+#define SCHED_FIFO     1 // 实时任务,运行到阻塞或被更高优先级的任务抢占
+#define SCHED_RR       2 // 实时任务,同优先级的任务按时间片轮转
+#define SCHED_DEADLINE 3 // 周期性任务(EDF),只能通过KERN_SET_DEADLINE设置
+
+// set slice
+#define IN_KERN_SET_SLICE_PID   0
+#define IN_KERN_SET_SLICE_SLICE 1 // 请求的时间片(ns),0表示默认值
+
+// cpu位图占用的消息项数,第n项的第m位对应cpu_id为n * 64 + m的cpu
+#define AFFINITY_MASK_WORDS 4
+
+// set affinity
+#define IN_KERN_SET_AFFINITY_PID  0
+#define IN_KERN_SET_AFFINITY_MASK 1 // 1 ~ AFFINITY_MASK_WORDS
+
+// get affinity
+#define IN_KERN_GET_AFFINITY_PID 0
+
+#define OUT_KERN_GET_AFFINITY_MASK 0 // 0 ~ AFFINITY_MASK_WORDS - 1
+
+// get sched avg
+#define IN_KERN_GET_SCHED_AVG_PID 0
+
+#define OUT_KERN_GET_SCHED_AVG_LOAD         0 // 任务可运行时的权重的平均值
+#define OUT_KERN_GET_SCHED_AVG_RUNNABLE     1 // 任务可运行的时间比例
+#define OUT_KERN_GET_SCHED_AVG_UTIL         2 // 任务正在运行的时间比例
+#define OUT_KERN_GET_SCHED_AVG_CPU          3 // 任务所在的cpu
+#define OUT_KERN_GET_SCHED_AVG_CPU_LOAD     4 // cpu的负载的平均值
+#define OUT_KERN_GET_SCHED_AVG_CPU_RUNNABLE 5 // cpu可运行的任务数的平均值
+#define OUT_KERN_GET_SCHED_AVG_CPU_UTIL     6 // cpu的利用率
+
+// create group
+#define IN_KERN_CREATE_GROUP_WEIGHT 0
+
+#define OUT_KERN_CREATE_GROUP_ID 0
+
+// set group weight
+#define IN_KERN_SET_GROUP_WEIGHT_ID     0
+#define IN_KERN_SET_GROUP_WEIGHT_WEIGHT 1
+
+// set group
+#define IN_KERN_SET_GROUP_PID 0
+#define IN_KERN_SET_GROUP_ID  1 // 0为根任务组
+
+// get group
+#define IN_KERN_GET_GROUP_PID 0
+
+#define OUT_KERN_GET_GROUP_ID 0
+
+// set deadline
+#define IN_KERN_SET_DEADLINE_PID      0
+#define IN_KERN_SET_DEADLINE_RUNTIME  1 // 每个周期的运行时间(ns)
+#define IN_KERN_SET_DEADLINE_DEADLINE 2 // 相对截止时间(ns),0表示与周期相同
+#define IN_KERN_SET_DEADLINE_PERIOD   3 // 周期(ns)
+
+// 延迟直方图的桶数,第i个桶统计[2^i, 2^(i+1))ns的样本,
+// 第0个桶包括0,最后一个桶包括所有更大的样本
+#define SCHED_HIST_BUCKETS 32
+
+// 任务状态的数量,task_status_t的取值都小于此值
+#define SCHED_STAT_STATUSES 9
+
+// 任务的调度统计
+typedef struct task_sched_stat_s
+{
+    uint64_t nr_voluntary;       // 阻塞,休眠等主动让出cpu的次数
+    uint64_t nr_involuntary;     // 被抢占或让出cpu后仍就绪的次数
+    uint64_t nr_runs;            // 从就绪队列中被选中运行的次数
+    uint64_t rq_wait;            // 从进入就绪队列到开始运行的总时间(ns)
+    uint64_t rq_wait_max;        // 单次在就绪队列中等待的最长时间(ns)
+    uint64_t nr_wakeups;         // 被唤醒后开始运行的次数
+    uint64_t wakeup_latency;     // 从被唤醒到开始运行的总时间(ns)
+    uint64_t wakeup_latency_max; // 单次唤醒延迟的最大值(ns)
+
+    // 处于各状态的总时间(ns),下标为task_status_t的值,
+    // 当前所处的状态在下一次状态变化时才计入
+    uint64_t status_time[SCHED_STAT_STATUSES];
+} task_sched_stat_t;
+
+// cpu的调度统计,只由该cpu在调度时更新
+typedef struct cpu_sched_stat_s
+{
+    uint64_t nr_switches;    // 任务切换次数
+    uint64_t nr_voluntary;   // 切换时上一个任务主动让出cpu的次数
+    uint64_t nr_involuntary; // 切换时上一个任务被抢占的次数(不含idle)
+    uint64_t nr_runs;        // 从就绪队列中选中任务运行的次数
+    uint64_t rq_wait;        // 被选中的任务在就绪队列中等待的总时间(ns)
+    uint64_t nr_wakeups;     // 被唤醒的任务开始运行的次数
+    uint64_t wakeup_latency; // 唤醒延迟的总时间(ns)
+
+    uint64_t rq_wait_hist[SCHED_HIST_BUCKETS];        // 就绪队列等待时间
+    uint64_t wakeup_latency_hist[SCHED_HIST_BUCKETS]; // 唤醒延迟
+} cpu_sched_stat_t;
+
+// get task stat
+#define IN_KERN_GET_TASK_STAT_PID    0
+#define IN_KERN_GET_TASK_STAT_BUFFER 1 // task_sched_stat_t *
+
+// get cpu stat
+#define IN_KERN_GET_CPU_STAT_CPU    0
+#define IN_KERN_GET_CPU_STAT_BUFFER 1 // cpu_sched_stat_t *
+
+// shm create
+#define IN_KERN_SHM_CREATE_SIZE 0 // 按页(2 MiB)向上取整
+
+#define OUT_KERN_SHM_CREATE_HANDLE 0
+#define OUT_KERN_SHM_CREATE_ADDR   1
+
+// shm grant
+#define IN_KERN_SHM_GRANT_HANDLE 0
+#define IN_KERN_SHM_GRANT_PID    1
+
+// shm map
+#define IN_KERN_SHM_MAP_HANDLE 0
+
+#define OUT_KERN_SHM_MAP_ADDR 0
+#define OUT_KERN_SHM_MAP_SIZE 1
+
+// shm unmap
+#define IN_KERN_SHM_UNMAP_HANDLE 0
+
+// ring setup
+#define IN_KERN_RING_SETUP_HANDLE  0 // 存放环的共享内存区域(需已映射)
+#define IN_KERN_RING_SETUP_ENTRIES 1 // 提交与完成队列的容量(2的幂)
+#define IN_KERN_RING_SETUP_FLAGS   2
+
+// IN_KERN_RING_SETUP_FLAGS
+#define RING_SETUP_POLL (1 << 0) // 由内核的轮询任务处理请求,不需要系统调用
+
+// ring enter
+#define OUT_KERN_RING_ENTER_DONE 0 // 本次处理的请求数
+
+// 每个环最多的请求数
+#define RING_MAX_ENTRIES 4096
+
+// kernel_ring_t.flags的位
+#define RING_NEED_WAKEUP 0 // 轮询任务已休眠,提交后需KERN_RING_ENTER唤醒
+#define RING_NEED_ENTER  1 // 队首的请求不能由轮询任务处理,需KERN_RING_ENTER
+
+// 提交队列的项
+typedef struct ring_sqe_s
+{
+    uint64_t  user_data; // 原样复制到完成队列的项中
+    message_t msg;       // 内核服务请求,type为KERN_*
+} ring_sqe_t;
+
+// 完成队列的项
+typedef struct ring_cqe_s
+{
+    uint64_t  user_data;
+    uint64_t  status; // 内核服务的返回值(syscall_status_t)
+    message_t msg;    // 内核服务的回复
+} ring_cqe_t;
+
+// 共享内存区域开头的环的头部,其后依次为提交队列与完成队列的项
+typedef struct kernel_ring_s
+{
+    atomic_t sq_head; // 内核下一个处理的提交项
+    atomic_t cq_tail; // 内核下一个写入的完成项
+    atomic_t flags;
+
+    // 以下由任务修改,与内核修改的部分位于不同的缓存行
+    atomic_t sq_tail ALIGNED(CACHE_LINE_SIZE); // 任务下一个写入的提交项
+    atomic_t cq_head;                          // 任务下一个读出的完成项
+} ALIGNED(CACHE_LINE_SIZE) kernel_ring_t;
+
+#define RING_SQES(RING)                                                        \
+    ((ring_sqe_t *)((uint8_t *)(RING) + sizeof(kernel_ring_t)))
+#define RING_CQES(RING, ENTRIES) ((ring_cqe_t *)(RING_SQES(RING) + (ENTRIES)))
+
+// 容量为ENTRIES的环所需的共享内存大小
+#define RING_SIZE(ENTRIES)                                                     \
+    (sizeof(kernel_ring_t) +                                                   \
+     (ENTRIES) * (sizeof(ring_sqe_t) + sizeof(ring_cqe_t)))
+
 PUBLIC syscall_status_t kernel_services(message_t *msg);
 
+/**
+ * @brief 判断内核服务能否由环的轮询任务代为处理
+ * @param type 内核服务(KERN_*)
+ * @note 轮询任务不在请求者的地址空间中运行,
+ *       只能处理以msg->src识别调用者,也不访问用户内存的请求
+ */
+PUBLIC bool kernel_service_pollable(uint32_t type);
+
+/**
+ * @brief 初始化提交与完成队列,并启动轮询任务
+ */
+PUBLIC void kern_ring_init(void);
+
+/**
+ * @brief 进程退出时销毁其提交与完成队列
+ * @param pid 退出的进程
+ * @note 需在shm_task_exit之前调用
+ */
+PUBLIC void kern_ring_exit(pid_t pid);
+
 ////////////////////////////////////////////////////////////////////////////////
 // TICK                                                                       //
 ////////////////////////////////////////////////////////////////////////////////
@@ -111,6 +348,18 @@ PUBLIC void mm_main(void);
 #define IN_VIEW_FILL_X           4
 #define IN_VIEW_FILL_Y           5
 
+// 从共享内存区域中读取像素,不复制缓冲区
+#define VIEW_FILL_SHM 2
+
+#define IN_VIEW_FILL_SHM_HANDLE 0
+#define IN_VIEW_FILL_SHM_OFFSET 1
+#define IN_VIEW_FILL_SHM_XSIZE  2
+#define IN_VIEW_FILL_SHM_YSIZE  3
+#define IN_VIEW_FILL_SHM_X      4
+#define IN_VIEW_FILL_SHM_Y      5
+
+#define OUT_VIEW_FILL_SHM_STATUS 0 // SYSCALL_SUCCESS或SYSCALL_ERROR
+
 PUBLIC void view_main(void);
 
 #endif
\ No newline at end of file
@@ -23,4 +23,10 @@ PUBLIC uint64_t atomic_bts(atomic_t *atom, uint64_t bit);
 PUBLIC uint64_t atomic_btr(atomic_t *atom, uint64_t bit);
 PUBLIC uint64_t atomic_btc(atomic_t *atom, uint64_t bit);
 
+/**
+ * @brief atom的值等于old时将其设为value
+ * @return atom原来的值,与old相同时表示修改成功
+ */
+PUBLIC uint64_t atomic_cmpxchg(atomic_t *atom, uint64_t old, uint64_t value);
+
 #endif
\ No newline at end of file
@@ -13,13 +13,15 @@
 #    include <device/sse.h>
 #    include <kernel/syscall.h>
 #    include <lib/list.h>
+#    include <lib/rbtree.h>
 #    include <mem/vmm.h>
+#    include <service.h> // task_sched_stat_t,cpu_sched_stat_t
 #    include <sync/atomic.h>
 
 #endif /* __ASM_INCLUDE__ */
 
 // 最大支持的任务数
-#define TASKS 4096
+#define TASKS 32768
 
 // PID的最小值
 #define MIN_PID 0
@@ -40,6 +42,41 @@
 #define SERVICE_PRIORITY NICE_TO_PRIO(-10)
 #define IDLE_PRIORITY    NICE_TO_PRIO(20)
 
+// cpu利用率的满值
+#define UTIL_SCALE 1024
+
+// PELT负载跟踪的周期(以1024ns为单位,约1ms)
+#define PELT_PERIOD 1024
+
+// 任务默认请求的时间片(ns)
+#define SCHED_BASE_SLICE 3000000
+
+// 任务组的最大数量(包括根任务组,id为0)
+#define TASK_GROUPS 64
+
+// 一个任务最多可以拥有(创建且未释放)的任务组数量
+#define TASK_GROUPS_PER_OWNER 4
+
+// 任务组权重的默认值与范围
+#define TASK_GROUP_DEFAULT_WEIGHT 1024
+#define TASK_GROUP_MIN_WEIGHT     2
+#define TASK_GROUP_MAX_WEIGHT     262144
+
+// 实时优先级的数量(0 ~ RT_PRIORITIES - 1,数值越大优先级越高)
+#define RT_PRIORITIES 32
+
+// deadline任务带宽的定点数精度: 带宽 = (runtime << DL_BW_SHIFT) / deadline
+#define DL_BW_SHIFT 20
+
+// 每个cpu上可分配给用户地址空间的PCID数量,PCID 0用于内核页表
+#define PCIDS 64
+
+// pid映射表每个二级表中的项数
+#define PID_MAP_LEAF_ENTRIES 512
+
+// pid映射表的一级表项数
+#define PID_MAP_DIRS (TASKS / PID_MAP_LEAF_ENTRIES)
+
 #define TASK_STRUCT_KSTACK_BASE 8
 #define TASK_STRUCT_KSTACK_SIZE 16
 
@@ -56,6 +93,7 @@ typedef enum task_status_e
     TASK_SENDING,   // 任务正在发送消息
     TASK_RECEIVING, // 任务正在接收消息
     TASK_WAITING,   // 等待子任务结束
+    TASK_SLEEPING,  // 任务正在休眠
     TASK_DIED       // 任务结束
 } task_status_t;
 
@@ -73,52 +111,172 @@ typedef struct task_context_s
     uint64_t rdi;
 } task_context_t;
 
-typedef struct task_struct_s
+/**
+ * @brief 按周期指数衰减的负载平均值(PELT)
+ * @note 每经过一个周期,之前的贡献衰减为原来的y倍(y^32 = 1/2),
+ *       平均值约为最近几十毫秒内的加权平均
+ */
+typedef struct sched_avg_s
 {
-    task_context_t *context; // 任务上下文
+    uint64_t last_update;    // 上一次更新的时刻(以1024ns为单位)
+    uint64_t period_contrib; // 当前未满的周期中已经过的时间
+    uint64_t load_sum;       // Σ 可运行时的权重 * 时间 * y^n
+    uint64_t runnable_sum;   // Σ 可运行的任务数 * UTIL_SCALE * 时间 * y^n
+    uint64_t util_sum;       // Σ 正在运行 * UTIL_SCALE * 时间 * y^n
+    uint64_t load_avg;       // 可运行时的权重的平均值
+    uint64_t runnable_avg;   // 可运行的任务数的平均值(单位为UTIL_SCALE)
+    uint64_t util_avg;       // 正在运行的时间比例(0 ~ UTIL_SCALE)
+} sched_avg_t;
 
-    uintptr_t kstack_base; // 内核栈基地值
-    size_t    kstack_size; // 内核栈大小(字节)
+/**
+ * @brief cpu上一个PCID的使用情况
+ * @note gen与cpu的pcid_gen不同时,此PCID未被分配
+ */
+typedef struct pcid_slot_s
+{
+    uint64_t mm_id;   // 使用此PCID的地址空间
+    uint64_t gen;     // 分配此PCID时cpu的pcid_gen
+    uint64_t tlb_gen; // TLB中此PCID的项对应地址空间的哪个tlb_gen
+} pcid_slot_t;
 
-    uintptr_t ustack_base; // 用户栈基址(如果有)
-    size_t    ustack_size; // 用户栈大小(如果有)
+typedef struct cfs_rq_s cfs_rq_t;
+
+// 任务组,定义在schedule.c中
+typedef struct task_group_s task_group_t;
 
-    pid_t pid;  // 任务id
-    pid_t ppid; // 父级任务id
+/**
+ * @brief 参与公平调度的实体: 一个任务,或一个任务组在某个cpu上的代表
+ * @note EEVDF: vrun_time不大于所在队列平均vrun_time的实体是合格的,
+ *       调度时在合格的实体中选择虚拟截止时间最早的实体.
+ *       选中任务组的实体后,再在任务组的队列中选择
+ */
+typedef struct sched_entity_s
+{
+    rbtree_node_t rq_node;   // 实体在cfs_rq中的节点
+    uint64_t      weight;    // 权重
+    uint64_t      vrun_time; // 虚拟运行时间(ns)
+    uint64_t      deadline;  // 虚拟截止时间(ns)
+    uint64_t      slice;     // 请求的时间片(ns),越小被唤醒后越早运行
+    int64_t       vlag;      // 离开队列时平均vrun_time与vrun_time之差(ns)
+    uint64_t      min_vrun;  // 队列中以此实体为根的子树中最小的vrun_time
+    bool          on_rq;     // 实体是否在cfs_rq的树中
+    cfs_rq_t     *cfs_rq;    // 实体最近一次放入的队列
+    cfs_rq_t     *my_q;      // 任务组的实体所代表的队列,任务为NULL
+} sched_entity_t;
+
+/**
+ * @brief 公平调度的就绪队列
+ * @note 正在运行的实体不在树中,由curr记录.
+ *       任务组的队列中有就绪的实体时,任务组的实体在上一级队列中
+ */
+struct cfs_rq_s
+{
+    rbtree_t        tree;          // 按deadline排序,附加子树中最小的vrun_time
+    uint64_t        min_vrun_time; // 最小虚拟运行时间(单调递增)
+    int64_t         avg_vrun;      // Σ(vrun_time - min_vrun_time) * 权重
+    uint64_t        nr_queued;     // 树中的实体数量
+    uint64_t        load;          // 树中的实体总权重
+    sched_entity_t *curr;          // 正在运行的实体
+    sched_entity_t *se;            // 拥有此队列的任务组实体,cpu的根队列为NULL
+};
 
-    char                   name[32];      // 任务名
-    volatile task_status_t status;        // 任务状态
-    uint64_t               preempt_count; // 抢占计数
-    uint64_t               cpu_id;        // 任务所在cpu的id
-    uint64_t              *page_dir;      // 任务页表地址(物理地址)
-    list_node_t            general_tag;   // 任务在任务列表中的节点
+/**
+ * @brief 任务结构体
+ * @note 按访问频率排列: 第一个缓存行是每次调度都会访问的字段,
+ *       其后是调度器使用的其他字段,IPC,子任务与地址表等只在系统调用中
+ *       访问的字段从新的缓存行开始,以免与调度器的字段共享缓存行
+ */
+typedef struct task_struct_s
+{
+    // 第一个缓存行,kstack_base与kstack_size的偏移由汇编代码使用
+    task_context_t        *context;        // 任务上下文
+    uintptr_t              kstack_base;    // 内核栈基地值
+    size_t                 kstack_size;    // 内核栈大小(字节)
+    volatile task_status_t status;         // 任务状态
+    uint32_t               policy;         // 调度策略(SCHED_NORMAL等)
+    uint64_t               preempt_count;  // 抢占计数
+    uint64_t               cpu_id;         // 任务所在cpu的id
+    uint64_t               exec_start;     // 上一次计时的TSC值
+    uint64_t               slice_run_time; // 本次被调度后连续运行的时间(ns)
+
+    bool     on_rq;       // 任务是否在就绪队列中
+    bool     on_cpu;      // 任务是否正在cpu上运行(切换完成前也为TRUE)
+    uint16_t pcid;        // 最近一次使用的PCID(仅作为提示)
+    uint32_t rt_priority; // 实时优先级
+    uint64_t priority;    // 任务优先级
+    uint64_t run_time;    // 任务运行时间(总计,ns)
+    uint64_t wait_start;  // 进入就绪队列时的TSC值
+    uint64_t user_time;   // 用户态运行时间(ns)
+    uint64_t kernel_time; // 内核态运行时间(ns)
+    uint64_t wait_time;   // 在就绪队列中等待的时间(ns)
+
+    uint64_t        *page_dir;      // 任务页表地址(物理地址)
+    uint64_t         mm_id;         // 地址空间的唯一标识,内核任务为0
+    uint64_t         tlb_gen;       // 解除或修改页表中映射的次数
+    fxsave_region_t *fxsave_region; // 用于fxsave/fxrstor指令
+    uint32_t         fpu_cpu; // 最近一次将fxsave_region载入寄存器的cpu
+
+    sched_entity_t se;    // 任务的公平调度实体
+    task_group_t  *group; // 任务所属的任务组,NULL表示根任务组
+
+    uint64_t    rt_slice_left; // SCHED_RR剩余的时间片(ns)
+    list_node_t rt_tag;        // 任务在实时就绪队列中的节点
+
+    // SCHED_DEADLINE: 每dl_period内在dl_deadline之前得到dl_runtime的运行时间
+    uint64_t      dl_runtime;      // 每个周期的运行时间(ns)
+    uint64_t      dl_deadline;     // 相对于周期开始的截止时间(ns)
+    uint64_t      dl_period;       // 周期(ns)
+    uint64_t      dl_bw;           // 占用所在cpu的带宽(DL_BW_SHIFT定点数)
+    int64_t       dl_budget;       // 当前截止时间之前剩余的运行时间(ns)
+    uint64_t      dl_abs_deadline; // 当前的绝对截止时间(ns)
+    bool          dl_throttled;    // 预算用完,等待下一个周期补充
+    rbtree_node_t dl_node;         // 任务在deadline就绪队列或限制队列中的节点
+
+    // 调度统计,只在任务所在cpu上持有task_list_lock或切换时更新
+    task_sched_stat_t sched_stat;
+    task_status_t     stat_status;       // sched_stat中正在计时的状态
+    uint64_t          stat_status_start; // 进入stat_status时的TSC值
+    uint64_t          wakeup_start;      // 被唤醒时的TSC值,开始运行后清零
+
+    sched_avg_t avg; // 任务的负载跟踪,由任务所在cpu的task_list_lock保护
+
+    cpumask_t   cpus_allowed; // 任务可以运行的cpu,cpu_id总在其中
+    list_node_t general_tag;  // 任务在等待队列等任务列表中的节点
+
+    // 以下字段只在系统调用与任务创建,退出时访问
+    pid_t pid ALIGNED(CACHE_LINE_SIZE); // 任务id
+    pid_t ppid;                         // 父级任务id
+    char  name[32];                     // 任务名
+    // 引用计数(pid_map与每个task_get各持有一个),由tasks_lock保护
+    uint64_t refs;
 
-    uint64_t priority;  // 任务优先级
-    uint64_t run_time;  // 任务运行时间(总计)
-    uint64_t vrun_time; // 虚拟运行时间
+    uintptr_t ustack_base; // 用户栈基址(如果有)
+    size_t    ustack_size; // 用户栈大小(如果有)
 
     vmm_struct_t vmm_free;  // 任务可以使用的虚拟地址表
     vmm_struct_t vmm_using; // 任务正在使用的虚拟地址表
+    // 保护vmm_free与vmm_using(环的轮询任务也会分配),持有时需关闭中断
+    spinlock_t vmm_lock;
 
-    message_t msg;       // 任务消息结构体
-    pid_t     send_to;   // 任务发送消息的目的地
-    pid_t     recv_from; // 任务接收消息的来源
-
-    atomic_t send_flag; // 任务发送消息的状态标志
-    atomic_t recv_flag; // 任务接收消息的状态标志
+    message_t  msg;           // 任务消息结构体
+    pid_t      send_to;       // 任务发送消息的目的地
+    pid_t      recv_from;     // 任务接收消息的来源
+    message_t *recv_buf;      // 阻塞在msg_recv中时接收消息的缓冲区
+    bool       ipc_delivered; // 发送者已将消息直接复制到recv_buf
 
     uint32_t    has_intr_msg; // 任务如果有来自中断的消息,由此变量记录
-    spinlock_t  send_lock;    // 操作任务的sender_list时需要获取此锁
+    spinlock_t  send_lock;    // 操作任务的IPC状态时需要获取此锁(需关闭中断)
     list_t      sender_list;  // 向任务发送消息的所有任务列表
     list_node_t send_tag; // 向其他任务发送消息时,用于加入目标任务的sender_list
+    mailbox_t   mailbox;  // 异步消息邮箱
 
-    atomic_t   childs; // 子任务数量总计
-    spinlock_t child_list_lock;
-    list_t     exited_child_list; // 子任务退出时将自身general_tag加入此列表
-    int        return_status;     // 任务结束时的返回值
-
-    fxsave_region_t *fxsave_region; // 用于fxsave/fxrstor指令
-} task_struct_t;
+    atomic_t    childs; // 子任务数量总计
+    spinlock_t  child_list_lock;
+    list_t      child_list;        // 所有子任务(包括已退出但未回收的)
+    list_node_t child_tag;         // 任务在父任务的child_list中的节点
+    list_t      exited_child_list; // 子任务退出时将自身general_tag加入此列表
+    int         return_status;     // 任务结束时的返回值
+} ALIGNED(CACHE_LINE_SIZE) task_struct_t;
 
 STATIC_ASSERT(
     OFFSET(task_struct_t, kstack_base) == TASK_STRUCT_KSTACK_BASE,
@@ -128,34 +286,81 @@ STATIC_ASSERT(
     OFFSET(task_struct_t, kstack_size) == TASK_STRUCT_KSTACK_SIZE,
     ""
 );
+STATIC_ASSERT(OFFSET(task_struct_t, on_rq) == CACHE_LINE_SIZE, "");
 
 /**
  * @brief the task management struct for each cpu
+ * @note 按缓存行对齐,相邻cpu的结构不共享缓存行.
+ *       其他cpu会访问的就绪队列与负载在前,只由所属cpu访问的字段
+ *       从新的缓存行开始
  */
 typedef struct task_man_s
 {
-    list_t     task_list; // 任务队列
-    spinlock_t task_list_lock;
-
-    // 因各种原因需要到特定情况才能继续运行的任务
-    // 只能操作各个cpu自己的waiting_task_list,因此不用上锁
-    list_t waiting_list;
+    cfs_rq_t   cfs;            // 公平调度的根队列
+    spinlock_t task_list_lock; // 可能在中断中获取,持有时需关闭中断
 
-    uint64_t       min_vrun_time; // 最小虚拟运行时间
-    uint64_t       running_tasks; // task_list中的任务数量
-    uint64_t       total_weight;  // task_list中的任务总权重
+    uint64_t       running_tasks; // 就绪队列(包括任务组的队列)中的任务数量
+    uint64_t       total_weight;  // 就绪队列中的任务总权重
     task_struct_t *main_task;
     task_struct_t *idle_task;
-} task_man_t;
+
+    uint32_t       cpu_id;       // 此结构所属的cpu
+    task_struct_t *curr;         // cpu上正在运行的任务
+    task_struct_t *prev_task;    // 上一次任务切换前运行的任务
+    uint64_t       next_balance; // 下一次周期性负载均衡的时刻(ticks)
+    sched_avg_t    avg;          // cpu的负载跟踪,由task_list_lock保护
+    volatile bool  need_resched; // 中断返回时需要进行调度
+
+    // deadline就绪队列,先于实时就绪队列被检查
+    rbtree_t dl_tree;          // 按绝对截止时间排序
+    rbtree_t dl_throttle_tree; // 预算用完的任务,按下一个周期的开始时刻排序
+    uint64_t dl_running;       // dl_tree中的任务数量
+    uint64_t dl_nr_throttled;  // dl_throttle_tree中的任务数量
+    uint64_t dl_bw;            // 已接纳的deadline任务的总带宽
+
+    // 实时就绪队列,每个实时优先级一个FIFO队列,总是先于cfs被检查
+    list_t   rt_queue[RT_PRIORITIES];
+    uint32_t rt_bitmap;       // 非空的rt_queue
+    uint64_t rt_running;      // 实时就绪队列中的任务数量
+    uint64_t rt_time;         // 本周期内实时任务已运行的时间(ns)
+    uint64_t rt_period_start; // 本周期开始的时刻(ns)
+    bool     rt_throttled;    // 实时任务已用完本周期的配额
+
+    // FPU/SSE寄存器中保存的是哪个任务的状态,此后的字段只由所属cpu访问
+    task_struct_t *fpu_owner ALIGNED(CACHE_LINE_SIZE);
+
+    bool     fpu_in_use;   // 当前任务在本次运行期间是否使用了FPU/SSE
+    uint64_t fpu_switches; // 任务切换次数
+    uint64_t fpu_saves;    // 切换时执行fxsave的次数
+    uint64_t fpu_restores; // #NM中执行fxrstor的次数
+
+    cpu_sched_stat_t sched_stat; // 调度统计
+
+    // 地址空间切换,只在所属cpu上关闭中断后访问
+    uint64_t   *cr3_page_dir; // cr3中的页表(物理地址)
+    bool        pcid_enabled; // cpu是否启用了PCID
+    uint32_t    pcid_next;    // 下一个分配的PCID
+    uint64_t    pcid_gen;     // PCID分配完一轮后增加,并刷新整个TLB
+    uint64_t    mm_seq;       // 在此cpu上分配的地址空间标识数量
+    pcid_slot_t pcids[PCIDS]; // 各PCID的使用情况
+} ALIGNED(CACHE_LINE_SIZE) task_man_t;
 
 /**
  * @brief the task management struct
  */
 typedef struct global_task_man_s
 {
-    task_struct_t tasks[TASKS];
-    spinlock_t    tasks_lock;
-    task_man_t    cpus[NR_CPUS];
+    // pid到任务结构体的映射,二级表在分配到对应范围的pid时才分配
+    task_struct_t **pid_map[PID_MAP_DIRS];
+    uint64_t        pid_bitmap[TASKS / 64]; // 已分配的pid
+    pid_t           next_pid;   // 下一次分配pid时开始查找的位置
+    spinlock_t      tasks_lock; // 保护pid_map,pid_bitmap,next_pid与free_tasks
+    list_t          free_tasks; // 引用计数为0的任务结构体,由task_alloc重用
+    task_man_t      cpus[NR_CPUS];
+
+    // 任务组,下标为任务组的id,根任务组(id为0)没有对应的结构体
+    task_group_t *groups[TASK_GROUPS];
+    spinlock_t    groups_lock; // 保护groups,任务组的属主与成员数量
 } global_task_man_t;
 
 /**
@@ -174,10 +379,29 @@ PUBLIC task_man_t *get_task_man(uint32_t cpu_id);
 /**
  * @brief 将pid转换为task结构体
  * @param pid pid
- * @note 0 <= pid <= MAX_PID
+ * @return 任务结构体指针,pid对应的任务不存在时返回NULL
+ * @note 调用者需确保任务在使用期间不会被回收(如当前任务,其父任务,
+ *       或正阻塞在向当前任务发送消息中的任务),否则应使用task_get
  */
 PUBLIC task_struct_t *pid_to_task(pid_t pid);
 
+/**
+ * @brief 获取pid对应的任务并增加其引用计数
+ * @param pid pid
+ * @return 任务结构体指针,pid对应的任务不存在时返回NULL
+ * @note 任务被回收后结构体在task_put前仍然有效(状态为TASK_DIED),
+ *       使用完毕后需调用task_put
+ */
+PUBLIC task_struct_t *task_get(pid_t pid);
+
+/**
+ * @brief 释放task_get获取的引用
+ * @param task 任务
+ * @note 最后一个引用被释放时任务结构体放入空闲列表,只被task_alloc重用,
+ *       不归还给kmalloc,因此可以在中断中调用
+ */
+PUBLIC void task_put(task_struct_t *task);
+
 /**
  * @brief 判断pid对应的任务是否存在
  * @param pid pid
@@ -191,17 +415,25 @@ PUBLIC bool task_exist(pid_t pid);
 PUBLIC task_struct_t *running_task(void);
 
 /**
- * @brief 在任务表中分配一个任务
+ * @brief 分配一个任务结构体与pid
  * @return 成功将返回任务结构体指针,失败返回NULL
  */
 PUBLIC task_struct_t *task_alloc(void);
 
 /**
- * @brief 将pid对应的任务结构体标记为未使用
+ * @brief 释放任务结构体与pid
  * @param task task结构体
  */
 PUBLIC void task_free(task_struct_t *task);
 
+/**
+ * @brief 将任务加入父任务的子任务列表
+ * @param parent 父任务
+ * @param child 子任务
+ * @note 子任务继承父任务的任务组,需在子任务加入就绪队列前调用
+ */
+PUBLIC void task_add_child(task_struct_t *parent, task_struct_t *child);
+
 /**
  * @brief 初始化一个任务结构体
  * @param task 任务结构体指针
@@ -276,16 +508,174 @@ PUBLIC void task_init(void);
 /// schedule.c
 
 /**
- * @brief 获取cpu的最小vrun_time
+ * @brief 初始化公平调度的就绪队列
+ * @param cfs 就绪队列
+ * @param se 拥有此队列的任务组实体,cpu的根队列为NULL
+ */
+PUBLIC void init_cfs_rq(cfs_rq_t *cfs, sched_entity_t *se);
+
+/**
+ * @brief 获取优先级对应的权重
+ * @param priority 任务优先级
+ */
+PUBLIC uint64_t sched_prio_to_weight(uint64_t priority);
+
+/**
+ * @brief 获取cpu根队列的最小vrun_time
  * @param cpu_id cpu id
  */
 PUBLIC uint64_t get_min_vrun_time(uint32_t cpu_id);
 
 /**
- * @brief 更新当前任务的run_time,run_time以及min_run_time,并计算ideal_run_time
+ * @brief 将上一次计时以来经过的时间计入任务的运行时间,并更新vrun_time
+ * @param task 正在当前cpu上运行的任务
+ * @param user 这段时间任务是否运行在用户态
+ * @note 在进出内核、时钟中断与任务切换时调用
+ */
+PUBLIC void task_account(task_struct_t *task, bool user);
+
+/**
+ * @brief 时钟中断中调用,更新当前任务的运行时间,
+ *        当前任务的时间片用完时设置need_resched
  */
 PUBLIC void task_update(void);
 
+/**
+ * @brief 判断cpu的就绪队列(包括deadline与实时就绪队列)是否为空
+ * @param task_man 任务管理结构
+ * @note 需持有task_man->task_list_lock
+ */
+PUBLIC bool task_list_empty(task_man_t *task_man);
+
+/**
+ * @brief 设置任务的调度策略
+ * @param task 任务
+ * @param policy SCHED_NORMAL,SCHED_FIFO或SCHED_RR
+ * @param rt_priority 实时优先级(policy为SCHED_NORMAL时忽略)
+ * @return 成功返回K_SUCCESS,参数无效返回K_INVALID_PARAM
+ * @note SCHED_DEADLINE需使用task_set_deadline设置,
+ *       离开SCHED_DEADLINE时释放任务占用的带宽
+ */
+PUBLIC status_t
+task_set_scheduler(task_struct_t *task, uint32_t policy, uint32_t rt_priority);
+
+/**
+ * @brief 将任务设为SCHED_DEADLINE
+ * @param task 任务
+ * @param runtime 每个周期的运行时间(ns)
+ * @param deadline 相对于周期开始的截止时间(ns),为0时与period相同
+ * @param period 周期(ns)
+ * @return 成功返回K_SUCCESS,参数无效返回K_INVALID_PARAM,
+ *         任务所在cpu的剩余带宽不足时返回K_OUT_OF_RESOURCE
+ * @note 需满足runtime <= deadline <= period.
+ *       任务固定在所在的cpu上,该cpu上所有deadline任务的
+ *       runtime / deadline之和不超过上限时才被接纳,
+ *       因此每个任务都能在截止时间之前得到runtime.
+ *       任务用完runtime后被限制,直到下一个周期开始
+ */
+PUBLIC status_t task_set_deadline(
+    task_struct_t *task,
+    uint64_t       runtime,
+    uint64_t       deadline,
+    uint64_t       period
+);
+
+/**
+ * @brief 设置任务可以运行的cpu
+ * @param task 任务
+ * @param mask cpu位图
+ * @return 成功返回K_SUCCESS,mask中没有已启动的cpu时返回K_INVALID_PARAM
+ * @note 任务当前所在的cpu不在mask中时将被迁移:
+ *       就绪或阻塞的任务立即迁移,正在运行的任务在切换出去后迁移.
+ *       SCHED_DEADLINE的任务不能迁移,mask必须包含任务所在的cpu
+ */
+PUBLIC status_t task_set_affinity(task_struct_t *task, const cpumask_t *mask);
+
+/**
+ * @brief 设置任务请求的时间片(延迟提示)
+ * @param task 任务
+ * @param slice 时间片(ns),为0时恢复默认值
+ * @return 成功返回K_SUCCESS,超出范围返回K_INVALID_PARAM
+ * @note 时间片越小,任务的截止时间越早,被唤醒后越早运行,
+ *       但每次运行的时间也越短,总的cpu份额仍由权重决定
+ */
+PUBLIC status_t task_set_slice(task_struct_t *task, uint64_t slice);
+
+/**
+ * @brief 获取任务与其所在cpu的负载跟踪数据
+ * @param task 任务
+ * @param task_avg 任务的负载跟踪数据
+ * @param cpu_avg 任务所在cpu的负载跟踪数据
+ * @return 任务所在的cpu
+ * @note 获取前会将两者更新到当前时刻
+ */
+PUBLIC uint32_t task_get_sched_avg(
+    task_struct_t *task,
+    sched_avg_t   *task_avg,
+    sched_avg_t   *cpu_avg
+);
+
+/**
+ * @brief 创建任务组
+ * @param weight 任务组的权重
+ * @param owner 任务组的属主
+ * @param id 任务组的id
+ * @return 成功返回K_SUCCESS,权重超出范围返回K_INVALID_PARAM,
+ *         任务组数量或属主拥有的任务组数量达到上限,内存不足返回K_ERROR
+ * @note 任务组在每个cpu上有自己的队列与实体,
+ *       cpu时间先按权重在任务组之间分配,再在组内的任务之间分配.
+ *       属主被回收且组内没有任务后任务组被释放
+ */
+PUBLIC status_t task_group_create(uint64_t weight, pid_t owner, uint32_t *id);
+
+/**
+ * @brief 设置任务组的权重
+ * @param id 任务组的id(不能是根任务组)
+ * @param weight 任务组的权重
+ * @param caller 调用者,只能是任务组的属主,PID_NO_TASK表示内核
+ * @return 成功返回K_SUCCESS,参数无效或调用者不是属主返回K_INVALID_PARAM
+ */
+PUBLIC status_t
+task_group_set_weight(uint32_t id, uint64_t weight, pid_t caller);
+
+/**
+ * @brief 将任务移动到任务组中
+ * @param task 任务
+ * @param id 任务组的id,0为根任务组
+ * @param caller 调用者,PID_NO_TASK表示内核
+ * @return 成功返回K_SUCCESS,任务组不存在,任务已退出或调用者不是原任务组
+ *         与新任务组(根任务组除外)的属主时返回K_INVALID_PARAM
+ * @note 正在运行的任务在下一次放回就绪队列时进入新的任务组
+ */
+PUBLIC status_t task_set_group(task_struct_t *task, uint32_t id, pid_t caller);
+
+/**
+ * @brief 获取任务所属任务组的id
+ * @param task 任务
+ */
+PUBLIC uint32_t task_get_group(task_struct_t *task);
+
+/**
+ * @brief 子任务加入父任务的任务组
+ * @param child 子任务
+ * @param parent 父任务
+ */
+PUBLIC void task_group_inherit(task_struct_t *child, task_struct_t *parent);
+
+/**
+ * @brief 任务离开任务组,并放弃其拥有的任务组
+ * @param task 任务
+ * @note 在回收任务时调用,此时任务已不在任何就绪队列中
+ */
+PUBLIC void task_group_exit(task_struct_t *task);
+
+/**
+ * @brief 开启或关闭EEVDF
+ * @param enable 为FALSE时按vrun_time选择任务,被唤醒的任务保留原来的vrun_time
+ * @note 仅用于基准测试对比两种策略
+ */
+PUBLIC void sched_set_eevdf(bool enable);
+
 /**
  * @brief 进行任务调度
  * @note 如果进程持有自旋锁,则不会触发调度
@@ -293,7 +683,19 @@ PUBLIC void task_update(void);
 PUBLIC void schedule(void);
 
 /**
- * @brief 将任务添加到列表中
+ * @brief 中断返回前调用,仅在当前cpu的need_resched被设置时进行调度
+ */
+PUBLIC void ASMLINKAGE schedule_if_needed(void);
+
+/**
+ * @brief 任务切换完成后的收尾工作
+ * @note 在切换后的任务中调用,此时上一个任务的上下文已保存完毕,
+ *       可以被其他cpu迁移
+ */
+PUBLIC void schedule_tail(void);
+
+/**
+ * @brief 将任务添加到就绪队列中
  * @param task_man 任务管理结构
  * @param task 要添加的任务结构体指针
  * @note 使用此函数前请确保获取了taskmgr的task_list_lock锁
@@ -306,20 +708,76 @@ PUBLIC void task_list_insert(task_man_t *task_man, task_struct_t *task);
  */
 PUBLIC void task_block(task_status_t status);
 
+/**
+ * @brief 将当前任务设为status状态,释放lock后进行调度
+ * @param status 阻塞后的任务状态
+ * @param lock 保护等待条件的锁(调用时必须持有)
+ * @note 调用前需关闭中断,返回时已重新获取lock.
+ *       唤醒者修改等待条件时需持有同一个锁,并在释放锁后调用task_wakeup,
+ *       因此检查条件与阻塞之间不会丢失唤醒.
+ *       任务可能被提前唤醒,调用者应在循环中重新检查等待条件
+ */
+PUBLIC void task_block_locked(task_status_t status, spinlock_t *lock);
+
+/**
+ * @brief 与task_block_locked相同,但最多阻塞milliseconds毫秒
+ * @param status 阻塞后的任务状态
+ * @param lock 保护等待条件的锁(调用时必须持有)
+ * @param milliseconds 超时时间(毫秒)
+ * @return 超时返回K_TIMEOUT,在超时前被唤醒则返回K_SUCCESS
+ * @note 调用前需关闭中断,返回时已重新获取lock
+ */
+PUBLIC status_t task_block_locked_timeout(
+    task_status_t status,
+    spinlock_t   *lock,
+    uint32_t      milliseconds
+);
+
+/**
+ * @brief 与task_block_locked相同,但直接切换到被唤醒的任务next
+ * @param status 阻塞后的任务状态
+ * @param lock 保护等待条件的锁(调用时必须持有)
+ * @param next 要唤醒的任务
+ * @param next_status next应处于的阻塞状态
+ * @note 调用前需关闭中断,返回时已重新获取lock.
+ *       next可以在当前cpu上立即运行时不经过就绪队列直接切换,
+ *       否则与task_wakeup后调用task_block_locked相同
+ */
+PUBLIC void task_block_handoff(
+    task_status_t  status,
+    spinlock_t    *lock,
+    task_struct_t *next,
+    task_status_t  next_status
+);
+
+/**
+ * @brief 唤醒处于status阻塞状态的任务
+ * @param task 要唤醒的任务
+ * @param status 任务应处于的阻塞状态
+ * @return 任务被唤醒时返回TRUE
+ * @note 任务不处于status状态(尚未阻塞或已被唤醒)时不做任何操作.
+ *       已切换出去的任务会被放到允许运行的cpu中负载最轻的一个,
+ *       原来的cpu空闲时优先留在原cpu
+ */
+PUBLIC bool task_wakeup(task_struct_t *task, task_status_t status);
+
 /**
  * @brief 将pid对应的进程解除阻塞
  * @param pid pid
+ * @note 与task_wakeup相同,会为新建或已切换出去的任务选择负载最轻的cpu
  */
 PUBLIC void task_unblock(pid_t pid);
 
 /**
  * @brief 将pid对应的进程解除阻塞,但不会操作task_list_lock锁
  * @param pid pid
+ * @return 需要向任务所在的cpu发送调度IPI时返回TRUE
  */
-PUBLIC void task_unblock_sub(pid_t pid);
+PUBLIC bool task_unblock_sub(pid_t pid);
 
 /**
  * @brief 使当前进程让出cpu
+ * @note SCHED_DEADLINE的任务放弃本周期剩余的运行时间,直到下一个周期开始
  */
 PUBLIC void task_yield(void);
 
@@ -329,19 +787,57 @@ PUBLIC void task_yield(void);
  */
 PUBLIC void task_msleep(uint32_t milliseconds);
 
+/// fpu.c
+
+/**
+ * @brief 注册#NM异常处理函数,启用延迟的FPU/SSE上下文切换
+ */
+PUBLIC void fpu_init(void);
+
+/**
+ * @brief 将当前cpu的FPU/SSE寄存器标记为属于正在运行的任务
+ * @note 在每个cpu启用SSE后调用一次
+ */
+PUBLIC void fpu_cpu_init(void);
+
+/**
+ * @brief 任务切换时保存任务的FPU/SSE状态
+ * @param task_man 当前cpu的任务管理结构
+ * @param task 即将被换下的任务
+ * @note 只有任务在本次运行期间使用过FPU/SSE时才执行fxsave,
+ *       之后设置CR0.TS,由下一个任务首次使用时的#NM异常恢复状态
+ */
+PUBLIC void fpu_switch_out(task_man_t *task_man, task_struct_t *task);
+
 /// tss.c
 PUBLIC void init_tss(uint8_t cpu_id);
 PUBLIC void update_tss_rsp0(task_struct_t *task);
 
 /// proc.c
 
+/**
+ * @brief 启用全局页与PCID(如果cpu支持),并刷新TLB
+ * @note 每个cpu在调度开始前调用一次
+ */
+PUBLIC void page_table_cpu_init(void);
+
 /**
  * @brief 激活任务的页表
+ * @note 与cr3中的页表相同时不写入cr3.启用PCID时,
+ *       仅在地址空间的TLB项可能已过期时刷新该PCID
  * @param task
  * @return
  */
 PUBLIC void page_table_activate(task_struct_t *task);
 
+/**
+ * @brief 任务页表中的映射被解除或修改后调用
+ * @note 调用前需已在当前cpu上刷新对应的TLB项(如invlpg),
+ *       其他cpu在下一次切换到该地址空间时刷新
+ * @param task
+ */
+PUBLIC void page_table_changed(task_struct_t *task);
+
 /**
  * @brief 激活任务的页表,更新tss的rsp0,设置gs_base
  * @param task
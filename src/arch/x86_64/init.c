@@ -146,6 +146,7 @@ PUBLIC void init_all(void)
 
     PR_LOG(LOG_INFO, "System Call initializing ...\n");
     syscall_init();
+    kern_ring_init();
 
     intr_enable();
 
@@ -200,7 +201,7 @@ PUBLIC void init_all(void)
     smp_start();
 
     *((uint64_t *)KERNEL_PAGE_DIR_TABLE_POS) = 0;
-    page_table_activate(running_task());
+    page_table_cpu_init();
     return;
 }
 
@@ -212,8 +213,11 @@ PUBLIC void ap_init_all(void)
     load_gdt();
     load_tss(cpu_id);
 
-    wrmsr(IA32_KERNEL_GS_BASE, (uint64_t)get_task_man(cpu_id)->main_task);
+    task_man_t *task_man = get_task_man(cpu_id);
+    wrmsr(IA32_KERNEL_GS_BASE, (uint64_t)task_man->main_task);
     running_task()->status = TASK_RUNNING;
+    running_task()->on_cpu = TRUE;
+    task_man->curr         = running_task();
 
     create_idle_task();
 
@@ -222,7 +226,9 @@ PUBLIC void ap_init_all(void)
     apic_timer_init();
 
     sse_enable();
+    fpu_cpu_init();
     syscall_init();
+    page_table_cpu_init();
 
     intr_enable();
 
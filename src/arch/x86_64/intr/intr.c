@@ -185,12 +185,27 @@ PUBLIC void default_irq_handler(intr_stack_t *stack)
 
 PUBLIC void ASMLINKAGE do_irq(intr_stack_t *stack)
 {
+    // 从用户态进入中断,此前的时间为用户态运行时间
+    if ((stack->cs & 3) != 0)
+    {
+        task_account(running_task(), TRUE);
+    }
     int int_vector                  = stack->int_vector;
     void (*handler)(intr_stack_t *) = irq_handler[int_vector];
     handler != NULL ? handler(stack) : default_irq_handler(stack);
     return;
 }
 
+PUBLIC void ASMLINKAGE do_irq_exit(intr_stack_t *stack)
+{
+    // 返回用户态,此前(包括中断处理与可能发生的任务切换)为内核态运行时间
+    if ((stack->cs & 3) != 0)
+    {
+        task_account(running_task(), FALSE);
+    }
+    return;
+}
+
 #define INTR_HANDLER(ENTRY, NR, ERROR_CODE) extern void ENTRY(intr_stack_t *);
 #include <intr.h>
 #undef INTR_HANDLER
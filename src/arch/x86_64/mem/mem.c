@@ -7,11 +7,14 @@
 
 #include <mem/allocator.h> // previous for mem_alloctor_init
 #include <mem/mem.h>       // previous for mem_init
-#include <mem/page.h>      // previous for mem_page_init
+#include <mem/page.h>      // previous for mem_page_init,page_global_init
+#include <mem/shm.h>       // shm_init
 
 PUBLIC void mem_init(void)
 {
     mem_page_init();
     mem_allocator_init();
+    page_global_init();
+    shm_init();
     return;
 }
\ No newline at end of file
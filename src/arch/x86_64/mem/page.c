@@ -8,11 +8,11 @@
 #include <log.h>
 
 #include <device/spinlock.h> // spinlock
-#include <io.h>              // get_cr2,get_cr3
+#include <io.h>              // get_cr2,get_cr3,invlpg
 #include <lib/bitmap.h>      // bitmap
 #include <mem/allocator.h>   // kmalloc
 #include <mem/page.h>        // previous
-#include <std/string.h>      // memset
+#include <std/string.h>      // memset,memcpy
 
 // do_page_fault
 #include <intr.h>      // register_handler
@@ -120,7 +120,7 @@ PRIVATE void do_page_fault(intr_stack_t *stack)
 {
     task_struct_t *task          = running_task();
     uintptr_t      fault_address = get_cr2();
-    uintptr_t      cr3           = get_cr3();
+    uintptr_t      cr3           = get_cr3() & ~0xfff; // 去除PCID
 
     uintptr_t fault_page = fault_address & ~(PG_SIZE - 1);
     // 内核任务 - 错误
@@ -130,7 +130,12 @@ PRIVATE void do_page_fault(intr_stack_t *stack)
     }
 
     // 未分配地址 - 错误
-    if (!vmm_find(&task->vmm_using, fault_page))
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&task->vmm_lock);
+    bool allocated = vmm_find(&task->vmm_using, fault_page);
+    spinlock_unlock(&task->vmm_lock);
+    intr_set_status(intr_status);
+    if (!allocated)
     {
         default_irq_handler(stack);
     }
@@ -455,6 +460,7 @@ PUBLIC void page_unmap(uint64_t *pml4t, void *vaddr)
     v_pde = PHYS_TO_VIRT(pde);
     ASSERT(*v_pde & PG_P);
     *v_pde &= ~PG_P;
+    invlpg(vaddr);
     return;
 }
 
@@ -478,6 +484,99 @@ PUBLIC void set_page_flags(uint64_t *pml4t, void *vaddr, uint64_t flags)
     v_pde = PHYS_TO_VIRT(pde);
     ASSERT(*v_pde & PG_P);
     *v_pde = (*v_pde & ~0xfff) | flags;
+    invlpg(vaddr);
+    return;
+}
+
+/**
+ * @brief 复制页目录指针表及其下的页目录表
+ * @param pdpt 页目录指针表(物理地址)
+ * @return 复制得到的页目录指针表(物理地址)
+ */
+PRIVATE uintptr_t copy_pdpt(uintptr_t pdpt)
+{
+    uint64_t *v_pdpt = PHYS_TO_VIRT(pdpt);
+    uint64_t *v_new_pdpt, *v_pdt;
+    status_t  status;
+    status = kmalloc(PT_SIZE, 0, PT_SIZE, &v_new_pdpt);
+    ASSERT(!ERROR(status));
+    memcpy(v_new_pdpt, v_pdpt, PT_SIZE);
+
+    int i;
+    for (i = 0; i < 512; i++)
+    {
+        if (!(v_pdpt[i] & PG_P) || (v_pdpt[i] & PG_SIZE_2M))
+        {
+            continue;
+        }
+        status = kmalloc(PT_SIZE, 0, PT_SIZE, &v_pdt);
+        ASSERT(!ERROR(status));
+        memcpy(v_pdt, PHYS_TO_VIRT(v_pdpt[i] & ~0xfff), PT_SIZE);
+        v_new_pdpt[i] = (uintptr_t)VIRT_TO_PHYS(v_pdt) | (v_pdpt[i] & 0xfff);
+    }
+    UNUSED(status);
+    return (uintptr_t)VIRT_TO_PHYS(v_new_pdpt);
+}
+
+/**
+ * @brief 为pdpt下的所有大页设置全局属性
+ * @param pdpt 页目录指针表(物理地址)
+ */
+PRIVATE void set_pdpt_global(uintptr_t pdpt)
+{
+    uint64_t *v_pdpt = PHYS_TO_VIRT(pdpt);
+    uint64_t *v_pdt;
+
+    int i, j;
+    for (i = 0; i < 512; i++)
+    {
+        if (!(v_pdpt[i] & PG_P))
+        {
+            continue;
+        }
+        if (v_pdpt[i] & PG_SIZE_2M) // 1G大页
+        {
+            v_pdpt[i] |= PG_G;
+            continue;
+        }
+        v_pdt = PHYS_TO_VIRT(v_pdpt[i] & ~0xfff);
+        for (j = 0; j < 512; j++)
+        {
+            if ((v_pdt[j] & PG_P) && (v_pdt[j] & PG_SIZE_2M))
+            {
+                v_pdt[j] |= PG_G;
+            }
+        }
+    }
+    return;
+}
+
+/**
+ * @brief 将内核空间(高256个pml4项)的映射设置为全局页
+ * @note 引导程序使恒等映射与直接映射共用页表,而恒等映射会被移除,
+ *       低地址也会被用户进程使用.因此先为直接映射复制一份页表,
+ *       只在副本中设置全局属性.需在启动AP与创建进程之前调用.
+ */
+PUBLIC void page_global_init(void)
+{
+    uint64_t *v_pml4t = PHYS_TO_VIRT(KERNEL_PAGE_DIR_TABLE_POS);
+    uintptr_t low_pdpt;
+    low_pdpt = (v_pml4t[0] & PG_P) ? (v_pml4t[0] & ~0xfff) : 0;
+
+    int i;
+    for (i = 256; i < 512; i++)
+    {
+        if (!(v_pml4t[i] & PG_P))
+        {
+            continue;
+        }
+        if ((v_pml4t[i] & ~0xfff) == low_pdpt)
+        {
+            v_pml4t[i] = copy_pdpt(low_pdpt) | (v_pml4t[i] & 0xfff);
+        }
+        set_pdpt_global(v_pml4t[i] & ~0xfff);
+    }
+    set_page_table((void *)KERNEL_PAGE_DIR_TABLE_POS);
     return;
 }
 
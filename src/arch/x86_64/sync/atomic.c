@@ -77,3 +77,11 @@ PUBLIC uint64_t atomic_btc(atomic_t *atom, uint64_t bit)
 {
     return asm_atomic_btc(&atom->value, bit);
 }
+
+extern uint64_t ASMLINKAGE
+asm_atomic_cmpxchg(volatile uint64_t *atom, uint64_t old, uint64_t value);
+
+PUBLIC uint64_t atomic_cmpxchg(atomic_t *atom, uint64_t old, uint64_t value)
+{
+    return asm_atomic_cmpxchg(&atom->value, old, value);
+}
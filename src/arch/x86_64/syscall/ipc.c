@@ -7,55 +7,305 @@
 
 #include <log.h>
 
+#include <intr.h> // intr_disable,intr_set_status
 #include <kernel/syscall.h>
+#include <mem/page.h>    // to_physical_address,PHYS_TO_VIRT
 #include <service.h>     // is_service_id,service_id_to_pid
 #include <std/string.h>  // memcpy
-#include <sync/atomic.h> // atomic_inc,atomic_dec
+#include <sync/atomic.h> // atomic_cmpxchg
 #include <task/task.h>   // task_struct_t running_task,list
 
+/**
+ * @brief 判断接收者是否正在等待来自src的消息
+ * @param receiver 接收者
+ * @param src 消息来源(pid或RECV_FROM_INT)
+ * @note 调用前需获取receiver->send_lock
+ */
+PRIVATE bool is_waiting_for(task_struct_t *receiver, pid_t src)
+{
+    pid_t recv_from = receiver->recv_from;
+    return recv_from == RECV_FROM_ANY || recv_from == src;
+}
+
+PUBLIC void mailbox_init(mailbox_t *mailbox)
+{
+    atomic_set(&mailbox->tail, 0);
+    mailbox->head = 0;
+    mailbox->turn = FALSE;
+    uint64_t i;
+    for (i = 0; i < MAILBOX_SIZE; i++)
+    {
+        atomic_set(&mailbox->slots[i].seq, i);
+    }
+    return;
+}
+
+/**
+ * @brief 将消息写入邮箱
+ * @param mailbox 邮箱
+ * @param msg 消息
+ * @return 邮箱已满时返回FALSE
+ * @note 可以由多个发送者同时调用.
+ *       发送者通过cmpxchg竞争写入位置,写入后更新槽的seq使接收者可见
+ */
+PRIVATE bool mailbox_push(mailbox_t *mailbox, message_t *msg)
+{
+    mailbox_slot_t *slot;
+    uint64_t        pos = atomic_read(&mailbox->tail);
+    while (1)
+    {
+        slot         = &mailbox->slots[pos & (MAILBOX_SIZE - 1)];
+        int64_t diff = (int64_t)(atomic_read(&slot->seq) - pos);
+        if (diff == 0)
+        {
+            uint64_t old = atomic_cmpxchg(&mailbox->tail, pos, pos + 1);
+            if (old == pos)
+            {
+                break;
+            }
+            pos = old;
+        }
+        else if (diff < 0)
+        {
+            // 此槽中上一轮的消息尚未被取出
+            return FALSE;
+        }
+        else
+        {
+            pos = atomic_read(&mailbox->tail);
+        }
+    }
+    memcpy(&slot->msg, msg, sizeof(message_t));
+    atomic_set(&slot->seq, pos + 1);
+    return TRUE;
+}
+
+/**
+ * @brief 邮箱中是否有可读出的消息
+ * @note 只由邮箱所属的任务调用
+ */
+PRIVATE bool mailbox_empty(mailbox_t *mailbox)
+{
+    uint64_t        head = mailbox->head;
+    mailbox_slot_t *slot = &mailbox->slots[head & (MAILBOX_SIZE - 1)];
+    return atomic_read(&slot->seq) != head + 1;
+}
+
+/**
+ * @brief 从邮箱中取出一条消息
+ * @param mailbox 邮箱
+ * @param msg 取出的消息
+ * @return 邮箱为空时返回FALSE
+ * @note 只由邮箱所属的任务调用
+ */
+PRIVATE bool mailbox_pop(mailbox_t *mailbox, message_t *msg)
+{
+    uint64_t        head = mailbox->head;
+    mailbox_slot_t *slot = &mailbox->slots[head & (MAILBOX_SIZE - 1)];
+    if (atomic_read(&slot->seq) != head + 1)
+    {
+        return FALSE;
+    }
+    memcpy(msg, &slot->msg, sizeof(message_t));
+    // 槽在下一轮中可以再次写入
+    atomic_set(&slot->seq, head + MAILBOX_SIZE);
+    mailbox->head = head + 1;
+    return TRUE;
+}
+
+/**
+ * @brief 查找邮箱中来自src的第一条消息
+ * @param mailbox 邮箱
+ * @param src 消息来源
+ * @param pos 消息的读出位置
+ * @return 没有来自src的消息时返回FALSE
+ * @note 只由邮箱所属的任务调用.
+ *       只查找从head开始连续可读出的消息,之后的消息写入时会再次唤醒接收者
+ */
+PRIVATE bool mailbox_find(mailbox_t *mailbox, pid_t src, uint64_t *pos)
+{
+    uint64_t i;
+    for (i = mailbox->head; i < mailbox->head + MAILBOX_SIZE; i++)
+    {
+        mailbox_slot_t *slot = &mailbox->slots[i & (MAILBOX_SIZE - 1)];
+        if (atomic_read(&slot->seq) != i + 1)
+        {
+            return FALSE;
+        }
+        if (slot->msg.src == src)
+        {
+            *pos = i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * @brief 从邮箱中取出mailbox_find找到的消息
+ * @param mailbox 邮箱
+ * @param pos 消息的读出位置
+ * @param msg 取出的消息
+ * @note 只由邮箱所属的任务调用.
+ *       pos之前的消息依次后移一个槽,其余消息保持原来的顺序
+ */
+PRIVATE void mailbox_pop_at(mailbox_t *mailbox, uint64_t pos, message_t *msg)
+{
+    mailbox_slot_t *slots = mailbox->slots;
+    memcpy(msg, &slots[pos & (MAILBOX_SIZE - 1)].msg, sizeof(message_t));
+    // head到pos之间的槽都已写入且未释放,发送者不会访问
+    for (; pos > mailbox->head; pos--)
+    {
+        memcpy(
+            &slots[pos & (MAILBOX_SIZE - 1)].msg,
+            &slots[(pos - 1) & (MAILBOX_SIZE - 1)].msg,
+            sizeof(message_t)
+        );
+    }
+    uint64_t head = mailbox->head;
+    atomic_set(&slots[head & (MAILBOX_SIZE - 1)].seq, head + MAILBOX_SIZE);
+    mailbox->head = head + 1;
+    return;
+}
+
 PUBLIC void inform_intr(pid_t dst)
 {
     if (is_service_id(dst))
     {
         dst = service_id_to_pid(dst);
     }
-    if (!task_exist(dst))
+    task_struct_t *receiver = task_get(dst);
+    if (receiver == NULL)
     {
         return;
     }
-    task_struct_t *receiver = pid_to_task(dst);
-    receiver->has_intr_msg  = 1;
+    intr_status_t intr_status = intr_disable();
+
+    spinlock_lock(&receiver->send_lock);
+    receiver->has_intr_msg = 1;
+    bool wakeup            = is_waiting_for(receiver, RECV_FROM_INT);
+    spinlock_unlock(&receiver->send_lock);
 
+    if (wakeup)
+    {
+        task_wakeup(receiver, TASK_RECEIVING);
+    }
+    intr_set_status(intr_status);
+    task_put(receiver);
     return;
 }
 
 /**
- * @brief 等待消息被接收
- * @param
- * @return
+ * @brief 接收者正在msg_recv中等待发送者时,将消息直接复制到接收者的缓冲区
+ * @param receiver 接收者
+ * @param msg 要发送的消息
+ * @return 消息已复制时返回TRUE
+ * @note 调用前需获取receiver->send_lock.
+ *       接收者的缓冲区位于其他地址空间时通过直接映射区访问,
+ *       缓冲区跨页或尚未映射时返回FALSE,由接收者从sender->msg中复制
  */
-PRIVATE void wait_receviced(void)
+PRIVATE bool deliver_direct(task_struct_t *receiver, message_t *msg)
 {
+    task_struct_t *sender = running_task();
+    message_t     *buf    = receiver->recv_buf;
+    if (buf == NULL || receiver->ipc_delivered ||
+        !is_waiting_for(receiver, sender->pid))
+    {
+        return FALSE;
+    }
+    // 短消息的缓冲区在接收者的内核栈上,可以直接访问
+    if (receiver->page_dir != NULL && receiver->page_dir != sender->page_dir &&
+        (uintptr_t)buf < KERNEL_VMA_BASE)
+    {
+        uintptr_t start = (uintptr_t)buf;
+        uintptr_t end   = start + sizeof(message_t) - 1;
+        if ((start & ~(PG_SIZE - 1)) != (end & ~(PG_SIZE - 1)))
+        {
+            return FALSE;
+        }
+        buf = to_physical_address(receiver->page_dir, buf);
+        if (buf == NULL)
+        {
+            return FALSE;
+        }
+        buf = PHYS_TO_VIRT(buf);
+    }
+    memcpy(buf, msg, sizeof(message_t));
+    receiver->recv_from     = PID_NO_TASK;
+    receiver->ipc_delivered = TRUE;
+    return TRUE;
+}
 
-    task_struct_t *sender   = running_task();
-    task_struct_t *receiver = pid_to_task(sender->send_to);
+/**
+ * @brief 等待消息被接收
+ * @param receiver 接收者(调用者持有其引用)
+ * @param msg 要发送的消息
+ * @param handoff 非NULL时,消息被直接复制后不唤醒接收者,
+ *                而是将其存入*handoff,由调用者切换到接收者
+ * @return 接收者已存入*handoff时返回TRUE
+ */
+PRIVATE bool wait_receviced(
+    task_struct_t  *receiver,
+    message_t      *msg,
+    task_struct_t **handoff
+)
+{
+    task_struct_t *sender      = running_task();
+    intr_status_t  intr_status = intr_disable();
 
     spinlock_lock(&receiver->send_lock);
+    if (deliver_direct(receiver, msg))
+    {
+        // 消息只复制一次,发送者无需阻塞等待接收者
+        sender->send_to = PID_NO_TASK;
+        spinlock_unlock(&receiver->send_lock);
+        if (handoff != NULL)
+        {
+            *handoff = receiver;
+        }
+        else
+        {
+            task_wakeup(receiver, TASK_RECEIVING);
+        }
+        intr_set_status(intr_status);
+        return handoff != NULL;
+    }
     list_append(&receiver->sender_list, &sender->send_tag);
+    bool wakeup = is_waiting_for(receiver, sender->pid);
     spinlock_unlock(&receiver->send_lock);
 
-    // 如果此刻receiver被唤醒,则sender->send_flag < 0
+    if (wakeup)
+    {
+        task_wakeup(receiver, TASK_RECEIVING);
+    }
 
-    atomic_inc(&sender->send_flag);
-    task_block(TASK_SENDING);
-    return;
+    // 消息被收到后,接收者将send_to设为PID_NO_TASK并唤醒发送者
+    spinlock_lock(&receiver->send_lock);
+    while (sender->send_to != PID_NO_TASK)
+    {
+        task_block_locked(TASK_SENDING, &receiver->send_lock);
+    }
+    spinlock_unlock(&receiver->send_lock);
+
+    intr_set_status(intr_status);
+    return FALSE;
 }
 
-PUBLIC syscall_status_t msg_send(pid_t dst, message_t *msg)
+/**
+ * @brief 发送消息
+ * @param dst 目标任务
+ * @param msg 要发送的消息
+ * @param handoff 见wait_receviced,存入*handoff的任务的引用转交给调用者
+ * @return
+ */
+PRIVATE syscall_status_t
+send_sub(pid_t dst, message_t *msg, task_struct_t **handoff)
 {
     task_struct_t *sender = running_task();
     sender->send_to       = PID_NO_TASK;
-    if (!task_exist(dst))
+    // 持有接收者的引用,接收者在等待期间被回收时其结构体仍然有效
+    task_struct_t *receiver = task_get(dst);
+    if (receiver == NULL)
     {
         return SYSCALL_DEST_NOT_EXIST;
     }
@@ -63,74 +313,117 @@ PUBLIC syscall_status_t msg_send(pid_t dst, message_t *msg)
     msg->src        = sender->pid;
 
     memcpy(&sender->msg, msg, sizeof(message_t));
-    wait_receviced();
+    if (!wait_receviced(receiver, msg, handoff))
+    {
+        task_put(receiver);
+    }
     return SYSCALL_SUCCESS;
 }
 
-/**
- * @brief 提醒消息发出者消息已被收到
- * @param pid
- * @return
- */
-PRIVATE void inform_received(pid_t pid)
+PUBLIC syscall_status_t msg_send(pid_t dst, message_t *msg)
 {
-    task_struct_t *sender = pid_to_task(pid);
-    sender->send_to       = PID_NO_TASK;
-    atomic_dec(&sender->send_flag);
-    return;
+    return send_sub(dst, msg, NULL);
+}
+
+PUBLIC syscall_status_t msg_send_async(pid_t dst, message_t *msg)
+{
+    task_struct_t *sender   = running_task();
+    task_struct_t *receiver = task_get(dst);
+    if (receiver == NULL)
+    {
+        return SYSCALL_DEST_NOT_EXIST;
+    }
+    msg->src = sender->pid;
+    if (!mailbox_push(&receiver->mailbox, msg))
+    {
+        task_put(receiver);
+        return SYSCALL_MAILBOX_FULL;
+    }
+
+    // 接收者在持有send_lock时检查邮箱后阻塞,在锁内判断可避免丢失唤醒.
+    // 等待特定任务的接收者也需唤醒: 它只查找连续可读出的消息,
+    // 此消息之后可能已有它在等待的消息
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&receiver->send_lock);
+    pid_t recv_from = receiver->recv_from;
+    bool  wakeup    = recv_from != PID_NO_TASK && recv_from != RECV_FROM_INT;
+    spinlock_unlock(&receiver->send_lock);
+    if (wakeup)
+    {
+        task_wakeup(receiver, TASK_RECEIVING);
+    }
+    intr_set_status(intr_status);
+    task_put(receiver);
+    return SYSCALL_SUCCESS;
 }
 
 /**
- * @brief 检测是否收到了来自任意进程的消息
- * @param pid pid
+ * @brief 提醒消息发出者消息已被收到
+ * @param sender 消息发出者
  * @return
  */
-PRIVATE int received_from_any_task(pid_t pid)
+PRIVATE void inform_received(task_struct_t *sender)
 {
-    task_struct_t *receiver = pid_to_task(pid);
+    task_struct_t *receiver    = running_task();
+    intr_status_t  intr_status = intr_disable();
 
     spinlock_lock(&receiver->send_lock);
-    int ret = !list_empty(&receiver->sender_list);
+    sender->send_to = PID_NO_TASK;
     spinlock_unlock(&receiver->send_lock);
+    task_wakeup(sender, TASK_SENDING);
 
-    return ret;
-}
-
-PRIVATE int received_from_intr(pid_t pid)
-{
-    task_struct_t *receiver = pid_to_task(pid);
-    return receiver->has_intr_msg;
+    intr_set_status(intr_status);
+    return;
 }
 
 /**
- * @brief 检测是否收到了任意消息
- * @param pid pid
+ * @brief 检测是否收到了来自src的消息
+ * @param receiver 接收者
+ * @param src 消息来源(pid,RECV_FROM_ANY或RECV_FROM_INT)
  * @return
+ * @note 调用前需获取receiver->send_lock
  */
-PRIVATE int received_any_message(pid_t pid)
+PRIVATE bool received_from(task_struct_t *receiver, pid_t src)
 {
-    return received_from_intr(pid) || received_from_any_task(pid);
+    if (receiver->ipc_delivered)
+    {
+        return TRUE;
+    }
+    if (src == RECV_FROM_INT)
+    {
+        return receiver->has_intr_msg;
+    }
+    if (src == RECV_FROM_ANY)
+    {
+        return receiver->has_intr_msg || !list_empty(&receiver->sender_list) ||
+               !mailbox_empty(&receiver->mailbox);
+    }
+    uint64_t pos;
+    if (mailbox_find(&receiver->mailbox, src, &pos))
+    {
+        return TRUE;
+    }
+    task_struct_t *sender = task_get(src);
+    if (sender == NULL)
+    {
+        return FALSE;
+    }
+    // 发送者在sender_list中时send_to为接收者,且send_tag已链入列表
+    bool received =
+        sender->send_to == receiver->pid && sender->send_tag.next != NULL;
+    task_put(sender);
+    return received;
 }
 
 /**
- * @brief 检测是否收到了来自特定进程的消息
- * @param pid
- * @param src
+ * @brief 接收消息
+ * @param src 消息来源(pid,RECV_FROM_ANY或RECV_FROM_INT)
+ * @param msg 接收消息的缓冲区
+ * @param handoff 已收到当前任务消息但尚未唤醒的任务,阻塞时直接切换到它
  * @return
  */
-PRIVATE int received_from(pid_t pid, pid_t src)
-{
-    task_struct_t *receiver = pid_to_task(pid);
-    task_struct_t *sender   = pid_to_task(src);
-
-    spinlock_lock(&receiver->send_lock);
-    int ret = list_find(&receiver->sender_list, &sender->send_tag);
-    spinlock_unlock(&receiver->send_lock);
-
-    return ret;
-}
-
-PUBLIC syscall_status_t msg_recv(pid_t src, message_t *msg)
+PRIVATE syscall_status_t
+recv_sub(pid_t src, message_t *msg, task_struct_t *handoff)
 {
     task_struct_t *receiver = running_task();
     task_struct_t *sender   = NULL;
@@ -142,82 +435,128 @@ PUBLIC syscall_status_t msg_recv(pid_t src, message_t *msg)
         // 从特定进程接收消息 - 确保对应进程存在
         if (!task_exist(src))
         {
+            if (handoff != NULL)
+            {
+                task_wakeup(handoff, TASK_RECEIVING);
+            }
             return SYSCALL_SRC_NOT_EXIST;
         }
     }
+
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&receiver->send_lock);
     receiver->recv_from = src;
+    receiver->recv_buf  = msg;
+    while (!received_from(receiver, src))
+    {
+        if (handoff != NULL)
+        {
+            task_block_handoff(
+                TASK_RECEIVING,
+                &receiver->send_lock,
+                handoff,
+                TASK_RECEIVING
+            );
+            handoff = NULL;
+            continue;
+        }
+        task_block_locked(TASK_RECEIVING, &receiver->send_lock);
+    }
+    receiver->recv_from = PID_NO_TASK;
+    receiver->recv_buf  = NULL;
 
-    atomic_set(&receiver->recv_flag, 1);
-    task_block(TASK_RECEIVING);
+    if (handoff != NULL)
+    {
+        // 未阻塞就已收到消息
+        spinlock_unlock(&receiver->send_lock);
+        task_wakeup(handoff, TASK_RECEIVING);
+        spinlock_lock(&receiver->send_lock);
+    }
+    if (receiver->ipc_delivered)
+    {
+        // 发送者已将消息复制到msg中,且没有等待通知
+        receiver->ipc_delivered = FALSE;
+        spinlock_unlock(&receiver->send_lock);
+        intr_set_status(intr_status);
+        return SYSCALL_SUCCESS;
+    }
 
-    if (src == RECV_FROM_ANY || src == RECV_FROM_INT)
+    if ((src == RECV_FROM_ANY || src == RECV_FROM_INT) &&
+        receiver->has_intr_msg)
     {
-        if (received_from_intr(receiver->pid))
+        receiver->has_intr_msg = 0;
+        spinlock_unlock(&receiver->send_lock);
+        intr_set_status(intr_status);
+
+        msg->src  = RECV_FROM_INT;
+        msg->type = RECV_FROM_INT;
+        return SYSCALL_SUCCESS;
+    }
+    mailbox_t *mailbox = &receiver->mailbox;
+    if (src == RECV_FROM_ANY)
+    {
+        // 同步与异步消息都有时交替接收,避免一方一直得不到处理
+        bool has_sync    = !list_empty(&receiver->sender_list);
+        bool has_async   = !mailbox_empty(mailbox);
+        bool use_mailbox = has_async && (!has_sync || mailbox->turn);
+        if (has_sync && has_async)
         {
-            receiver->recv_from    = PID_NO_TASK;
-            receiver->has_intr_msg = 0;
-            msg->src               = RECV_FROM_INT;
-            msg->type              = RECV_FROM_INT;
+            mailbox->turn = !use_mailbox;
+        }
+        if (use_mailbox)
+        {
+            spinlock_unlock(&receiver->send_lock);
+            intr_set_status(intr_status);
+            if (!mailbox_pop(mailbox, msg))
+            {
+                return SYSCALL_ERROR;
+            }
             return SYSCALL_SUCCESS;
         }
-        spinlock_lock(&receiver->send_lock);
-        list_node_t *src_node;
-        src_node = list_pop(&receiver->sender_list);
-        spinlock_unlock(&receiver->send_lock);
+        list_node_t *src_node = list_pop(&receiver->sender_list);
         sender = CONTAINER_OF(task_struct_t, send_tag, src_node);
     }
     else
     {
+        // 发送者阻塞前发出的异步消息早于它的同步消息,先接收
+        uint64_t pos;
+        if (mailbox_find(mailbox, src, &pos))
+        {
+            spinlock_unlock(&receiver->send_lock);
+            intr_set_status(intr_status);
+            mailbox_pop_at(mailbox, pos, msg);
+            return SYSCALL_SUCCESS;
+        }
+        // 发送者阻塞在sender_list中,不会被回收
         sender = pid_to_task(src);
-        spinlock_lock(&receiver->send_lock);
         list_remove(&sender->send_tag);
-        spinlock_unlock(&receiver->send_lock);
     }
+    spinlock_unlock(&receiver->send_lock);
+    intr_set_status(intr_status);
+
+    // 发送者在被通知前保持阻塞,其msg不会改变
     memcpy(msg, &sender->msg, sizeof(message_t));
-    receiver->recv_from = PID_NO_TASK;
-    inform_received(sender->pid);
+    inform_received(sender);
     return SYSCALL_SUCCESS;
 }
 
-PUBLIC int task_ipc_check(pid_t pid)
+PUBLIC syscall_status_t msg_recv(pid_t src, message_t *msg)
 {
-    task_struct_t *task = pid_to_task(pid);
+    return recv_sub(src, msg, NULL);
+}
 
-    if (atomic_read(&task->recv_flag) == 1)
+PUBLIC syscall_status_t msg_send_recv(pid_t dst, message_t *msg)
+{
+    task_struct_t   *handoff = NULL;
+    syscall_status_t ret     = send_sub(dst, msg, &handoff);
+    if (ret != SYSCALL_SUCCESS)
     {
-        // 没有收到任何消息
-        if (!received_any_message(task->pid))
-        {
-            return FALSE;
-        }
-        pid_t recv_from = task->recv_from;
-
-        if (recv_from == RECV_FROM_INT && !received_from_intr(task->pid))
-        {
-            return FALSE;
-        }
-        if (recv_from >= MIN_PID && recv_from <= MAX_PID)
-        {
-            if (!received_from(task->pid, recv_from))
-            {
-                return FALSE;
-            }
-        }
-
-        atomic_set(&task->recv_flag, 0);
-        return TRUE;
+        return ret;
     }
-
-    // send_flag用于标记消息发送的状态
-    // 消息被发出后,send_flag++
-    // 消息被收到后,send_flag--
-    // send_flag > 0 消息已发出,但未被收到 - 唤醒接收者并等待消息被收到(不可运行)
-    // send_flag = 0 没有发送消息或消息已发出且被收到 - 可运行
-    // send_flag < 0 消息已发出,在send_flag++前已被收到(小概率) - 可运行
-
-    if ((int64_t)atomic_read(&task->send_flag) > 0)
+    ret = recv_sub(dst, msg, handoff);
+    if (handoff != NULL)
     {
-        return FALSE;
+        task_put(handoff);
     }
-    return TRUE;
+    return ret;
 }
@@ -8,19 +8,27 @@
 #include <log.h>
 
 #include <device/cpu.h>     // wrmsr,rdmsr,IA32_EFER
-#include <kernel/syscall.h> // msg_send,msg_recv
+#include <kernel/syscall.h> // msg_send,msg_recv,msg_send_recv
 #include <service.h>        // is_service_id,service_id_to_pid
+#include <task/task.h>      // task_account
+
+// 短消息在syscall_entry中按此大小构造message_t
+STATIC_ASSERT(sizeof(message_t) == MESSAGE_SIZE, "");
 
 PUBLIC syscall_status_t ASMLINKAGE
 sys_send_recv(uint32_t function, pid_t src_dst, message_t *msg)
 {
+    task_struct_t *cur_task = running_task();
+    task_account(cur_task, TRUE);
+
     if (is_service_id(src_dst))
     {
         src_dst = service_id_to_pid(src_dst);
     }
-    if (function & 0x7ffffffc)
+    if (function & 0x7ffffff4)
     {
         PR_LOG(LOG_WARN, "unknow syscall nr: 0x%x", function);
+        task_account(cur_task, FALSE);
         return SYSCALL_NO_SYSCALL;
     }
     syscall_status_t ret = SYSCALL_SUCCESS;
@@ -32,7 +40,19 @@ sys_send_recv(uint32_t function, pid_t src_dst, message_t *msg)
     {
         if (src_dst == SEND_TO_KERNEL)
         {
-            ret = kernel_services(msg);
+            // 内核服务以msg->src识别调用者,不信任用户填写的值
+            msg->src = cur_task->pid;
+            ret      = kernel_services(msg);
+        }
+        else if (function & FUNC_ASYNC)
+        {
+            ret = msg_send_async(src_dst, msg);
+        }
+        else if (func_recv)
+        {
+            // 等待对方的回复,对方已在等待消息时直接切换过去
+            ret       = msg_send_recv(src_dst, msg);
+            func_recv = 0;
         }
         else
         {
@@ -45,10 +65,12 @@ sys_send_recv(uint32_t function, pid_t src_dst, message_t *msg)
         ret = msg_recv(src_dst, msg);
     }
 
-    if (ret != SYSCALL_SUCCESS)
+    // 邮箱已满是发送者需要处理的正常情况
+    if (ret != SYSCALL_SUCCESS && ret != SYSCALL_MAILBOX_FULL)
     {
         PR_LOG(LOG_WARN, "syscall error: %#x\n", ret);
     }
+    task_account(cur_task, FALSE);
     return ret;
 }
 
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/**
+ * Copyright (C) 2025 LinChenjun
+ */
+
+#include <kernel/global.h>
+
+#include <log.h>
+
+#include <device/sse.h> // asm_clts,asm_stts,asm_fxsave,asm_fxrstor
+#include <intr.h>       // register_handle,intr_stack_t
+#include <task/task.h>  // task_struct_t,task_man_t
+
+// 延迟的FPU/SSE上下文切换:
+// 任务切换时只保存本次运行中使用过FPU/SSE的任务的状态,并设置CR0.TS.
+// 下一个任务首次执行FPU/SSE指令时触发#NM,在#NM中清除CR0.TS并恢复状态.
+// 如果寄存器中仍是该任务的状态(期间没有其他任务在此cpu上使用过FPU/SSE),
+// 则不需要恢复.
+
+#define FPU_NM_VECTOR 0x07
+
+PRIVATE void fpu_nm_handler(intr_stack_t *stack)
+{
+    (void)stack;
+    task_struct_t *task     = running_task();
+    task_man_t    *task_man = get_task_man(task->cpu_id);
+
+    asm_clts();
+    task_man->fpu_in_use = TRUE;
+
+    if (task_man->fpu_owner == task && task->fpu_cpu == task_man->cpu_id)
+    {
+        return;
+    }
+    asm_fxrstor(task->fxsave_region);
+    task_man->fpu_owner = task;
+    task->fpu_cpu       = task_man->cpu_id;
+    task_man->fpu_restores++;
+    return;
+}
+
+PUBLIC void fpu_init(void)
+{
+    register_handle(FPU_NM_VECTOR, fpu_nm_handler);
+    return;
+}
+
+PUBLIC void fpu_cpu_init(void)
+{
+    task_struct_t *task     = running_task();
+    task_man_t    *task_man = get_task_man(task->cpu_id);
+
+    // 启用SSE后CR0.TS为0,寄存器中即为当前任务的状态
+    asm_clts();
+    task_man->fpu_owner  = task;
+    task_man->fpu_in_use = TRUE;
+    task->fpu_cpu        = task_man->cpu_id;
+    return;
+}
+
+PUBLIC void fpu_switch_out(task_man_t *task_man, task_struct_t *task)
+{
+    ASSERT(intr_get_status() == INTR_OFF);
+    task_man->fpu_switches++;
+    if (!task_man->fpu_in_use)
+    {
+        return;
+    }
+    // 寄存器中的状态仍属于task,换回此cpu时若没有其他任务使用过则无需恢复
+    asm_fxsave(task->fxsave_region);
+    task_man->fpu_saves++;
+    task_man->fpu_in_use = FALSE;
+    asm_stts();
+    return;
+}
@@ -7,11 +7,14 @@
 
 #include <log.h>
 
-#include <device/cpu.h>     // apic_id,IA32_KERNEL_GS_BASE
+#include <device/cpu.h>     // apic_id,IA32_KERNEL_GS_BASE,cpuid
+#include <intr.h>           // intr_disable,intr_set_status
+#include <io.h>             // get_cr3,set_cr3,get_cr4,set_cr4
 #include <kernel/syscall.h> // sys_send_recv
 #include <mem/allocator.h>  // kmalloc,kfree
 #include <mem/page.h>       // alloc_physical_page,page_map,set_page_table
-#include <service.h>        // MM_EXIT
+#include <mem/shm.h>        // shm_task_exit
+#include <service.h>        // MM_EXIT,kern_ring_exit
 #include <std/string.h>     // memset,memcpy
 #include <task/task.h>      // task struct & functions,spinlock
 
@@ -72,14 +75,160 @@ PRIVATE void start_process(void *process)
     return; // 应该永远不会到这里
 }
 
+// CR4.PGE: 启用全局页
+#define CR4_PGE (1 << 7)
+
+// CR4.PCIDE: 启用PCID,cr3的低12位为当前的PCID
+#define CR4_PCIDE (1 << 17)
+
+// 写入cr3时设置此位,则不刷新新PCID的TLB项
+#define CR3_NOFLUSH (1ULL << 63)
+
+/**
+ * @brief 刷新整个TLB,包括全局页与所有PCID的项
+ */
+PRIVATE void tlb_flush_all(void)
+{
+    uint64_t cr4 = get_cr4();
+    set_cr4(cr4 & ~CR4_PGE);
+    set_cr4(cr4);
+    return;
+}
+
+PUBLIC void page_table_cpu_init(void)
+{
+    intr_status_t  intr_status = intr_disable();
+    task_struct_t *task        = running_task();
+    task_man_t    *task_man    = get_task_man(task->cpu_id);
+
+    uint32_t a, b, c, d;
+    asm_cpuid(1, 0, &a, &b, &c, &d);
+
+    // 清除PGE以刷新整个TLB,启用PCIDE时cr3的低12位需为0
+    uint64_t cr4 = get_cr4() & ~(CR4_PGE | CR4_PCIDE);
+    set_cr4(cr4);
+    set_page_table((void *)KERNEL_PAGE_DIR_TABLE_POS);
+    if (d & (1 << 13)) // PGE
+    {
+        cr4 |= CR4_PGE;
+        // 分配完一轮PCID后需通过PGE刷新整个TLB
+        if (c & (1 << 17)) // PCID
+        {
+            cr4 |= CR4_PCIDE;
+        }
+    }
+    set_cr4(cr4);
+    task_man->pcid_enabled = (cr4 & CR4_PCIDE) != 0;
+    task_man->cr3_page_dir = (uint64_t *)KERNEL_PAGE_DIR_TABLE_POS;
+    page_table_activate(task);
+    intr_set_status(intr_status);
+    return;
+}
+
+/**
+ * @brief 获取地址空间在当前cpu上的PCID
+ * @param task_man 当前cpu的task_man
+ * @param task 使用该地址空间的任务
+ * @param flush 如果该PCID的TLB项可能已过期,设为TRUE
+ * @return PCID
+ */
+PRIVATE uint16_t
+pcid_get(task_man_t *task_man, task_struct_t *task, bool *flush)
+{
+    pcid_slot_t *slot = &task_man->pcids[task->pcid];
+    uint16_t     pcid = task->pcid;
+    *flush            = FALSE;
+
+    // task->pcid可能是在其他cpu上分配的,需确认其仍属于该地址空间
+    if (pcid == 0 || slot->gen != task_man->pcid_gen ||
+        slot->mm_id != task->mm_id)
+    {
+        for (pcid = 1; pcid < task_man->pcid_next; pcid++)
+        {
+            slot = &task_man->pcids[pcid];
+            if (slot->mm_id == task->mm_id)
+            {
+                break;
+            }
+        }
+    }
+    if (pcid == task_man->pcid_next)
+    {
+        // 分配完一轮后开始新的一代,旧的PCID全部失效
+        if (task_man->pcid_next == PCIDS)
+        {
+            task_man->pcid_gen++;
+            task_man->pcid_next = 1;
+            tlb_flush_all();
+        }
+        // 新分配的PCID在上一次刷新整个TLB后未被使用过
+        pcid          = task_man->pcid_next++;
+        slot          = &task_man->pcids[pcid];
+        slot->mm_id   = task->mm_id;
+        slot->gen     = task_man->pcid_gen;
+        slot->tlb_gen = task->tlb_gen;
+    }
+    if (slot->tlb_gen != task->tlb_gen)
+    {
+        slot->tlb_gen = task->tlb_gen;
+        *flush        = TRUE;
+    }
+    task->pcid = pcid;
+    return pcid;
+}
+
 PUBLIC void page_table_activate(task_struct_t *task)
 {
-    void *page_dir_table_pos = (void *)KERNEL_PAGE_DIR_TABLE_POS;
+    intr_status_t intr_status = intr_disable();
+    task_man_t   *task_man    = get_task_man(running_task()->cpu_id);
+
+    uint64_t *page_dir = (uint64_t *)KERNEL_PAGE_DIR_TABLE_POS;
     if (task->page_dir != NULL)
     {
-        page_dir_table_pos = task->page_dir;
+        page_dir = task->page_dir;
+    }
+    if (!task_man->pcid_enabled)
+    {
+        // 写入cr3会刷新TLB,地址空间不变时无需写入
+        if (page_dir != task_man->cr3_page_dir)
+        {
+            set_page_table(page_dir);
+            task_man->cr3_page_dir = page_dir;
+        }
+        intr_set_status(intr_status);
+        return;
+    }
+
+    // 内核页表使用PCID 0,其中只有全局页,无需刷新
+    uint16_t pcid  = 0;
+    bool     flush = FALSE;
+    if (task->page_dir != NULL)
+    {
+        pcid = pcid_get(task_man, task, &flush);
+    }
+    if (page_dir != task_man->cr3_page_dir || flush)
+    {
+        uint64_t cr3 = (uint64_t)page_dir | pcid;
+        set_cr3(flush ? cr3 : cr3 | CR3_NOFLUSH);
+        task_man->cr3_page_dir = page_dir;
     }
-    set_page_table(page_dir_table_pos);
+    intr_set_status(intr_status);
+    return;
+}
+
+PUBLIC void page_table_changed(task_struct_t *task)
+{
+    intr_status_t intr_status = intr_disable();
+    task_man_t   *task_man    = get_task_man(running_task()->cpu_id);
+
+    task->tlb_gen++;
+    // 当前cpu上已刷新,其他cpu上的PCID的tlb_gen不再相同
+    if (task_man->pcid_enabled && task->pcid != 0 &&
+        task_man->cr3_page_dir == task->page_dir)
+    {
+        task_man->pcids[task->pcid].tlb_gen = task->tlb_gen;
+    }
+    intr_set_status(intr_status);
     return;
 }
 
@@ -94,6 +243,20 @@ PUBLIC void proc_activate(task_struct_t *task)
     return;
 }
 
+/**
+ * @brief 分配地址空间的唯一标识
+ * @note 各cpu分别计数,低位为cpu_id,因此无需加锁
+ * @return 非0的标识
+ */
+PRIVATE uint64_t alloc_mm_id(void)
+{
+    intr_status_t intr_status = intr_disable();
+    task_man_t   *task_man    = get_task_man(running_task()->cpu_id);
+    uint64_t      mm_id = ++task_man->mm_seq * NR_CPUS + task_man->cpu_id;
+    intr_set_status(intr_status);
+    return mm_id;
+}
+
 PRIVATE uint64_t *create_page_dir(void)
 {
     uint64_t *pgdir_v;
@@ -177,6 +340,7 @@ PUBLIC task_struct_t *proc_execute(
         PR_LOG(LOG_ERROR, "Can not alloc memory for task page table.\n");
         goto fail;
     }
+    task->mm_id = alloc_mm_id();
     status = user_vaddr_table_init(task);
     ASSERT(!ERROR(status));
     if (ERROR(status))
@@ -184,10 +348,8 @@ PUBLIC task_struct_t *proc_execute(
         PR_LOG(LOG_ERROR, "Can not init vaddr table.\n");
         goto fail;
     }
-    task_man_t *task_man = get_task_man(task->cpu_id);
-    spinlock_lock(&task_man->task_list_lock);
-    task_list_insert(task_man, task);
-    spinlock_unlock(&task_man->task_list_lock);
+    task_add_child(running_task(), task);
+    task_unblock(task->pid);
     return task;
 
 fail:
@@ -203,6 +365,9 @@ PUBLIC void proc_exit(int status)
     task_struct_t *task   = running_task();
     void          *pg_dir = task->page_dir;
 
+    // 共享内存的物理页不随页表释放
+    kern_ring_exit(task->pid);
+    shm_task_exit(task);
     free_physical_page((void *)task->ustack_base, 1);
     // 使用内核页表,以便回收任务自身的页表
     task->page_dir = NULL;
@@ -7,11 +7,52 @@
 
 #include <log.h>
 
-#include <device/timer.h>   // MS_TO_TICKS,get_current_ticks
+#include <device/cpu.h>     // smp_send_reschedule
+#include <device/pic.h>     // apic
+#include <device/timer.h>   // MS_TO_TICKS,get_current_ticks,tsc_to_ns,timer_t
 #include <intr.h>           // intr functions
-#include <kernel/syscall.h> // task_ipc_check
+#include <io.h>             // read_tsc
+#include <mem/allocator.h>  // kmalloc,kfree
+#include <service.h>        // SCHED_NORMAL,SCHED_FIFO,SCHED_RR
+#include <std/string.h>     // memset
 #include <task/task.h>      // task structs & functions,list,sse
 
+extern apic_t apic;
+
+// 周期性负载均衡的间隔(毫秒)
+#define LOAD_BALANCE_INTERVAL 50
+
+// 一次负载均衡最多迁移的任务数
+#define LOAD_BALANCE_MAX_MOVE 8
+
+// 请求的时间片的范围(ns)
+#define SCHED_MIN_SLICE 100000
+#define SCHED_MAX_SLICE 100000000
+
+// 阻塞时保留的vlag的上限(ns,按时间片换算前至少为一个tick)
+#define SCHED_MIN_LAG 1000000
+
+// 关闭EEVDF时,被唤醒的任务的vrun_time比当前任务小超过此值(ns)时抢占当前任务
+#define WAKEUP_GRANULARITY 1000000
+
+// PELT: 1024 * Σ y^n (n >= 0),即长期满负载时的累计值
+#define PELT_LOAD_MAX 47742
+
+// 实时任务的带宽控制: 每RT_PERIOD(ns)内实时任务最多运行RT_RUNTIME(ns),
+// 剩余的时间留给普通任务,防止失控的实时任务使其他任务饿死
+#define RT_PERIOD  1000000000
+#define RT_RUNTIME 950000000
+
+// SCHED_RR的时间片(ns)
+#define RT_RR_TIMESLICE 10000000
+
+// 每个cpu上deadline任务的总带宽上限,与实时任务的配额相同
+#define DL_BW_LIMIT (((uint64_t)RT_RUNTIME << DL_BW_SHIFT) / RT_PERIOD)
+
+// deadline任务参数的范围(ns),预算在时钟中断中检查,因此runtime至少为一个tick
+#define DL_MIN_RUNTIME 1000000
+#define DL_MAX_PERIOD  4000000000
+
 PRIVATE const uint64_t task_prio_to_weight[40] = {
     /* -20 */ 88761, 71755, 56483, 46273, 36291,
     /* -15 */ 29154, 23254, 18705, 14949, 11916,
@@ -23,260 +64,2719 @@ PRIVATE const uint64_t task_prio_to_weight[40] = {
     /* +15 */ 36,    29,    23,    18,    15
 };
 
-PRIVATE void update_min_vrun_time(task_man_t *task_man, uint64_t vrun_time)
+// 为FALSE时使用EEVDF之前的策略(按vrun_time选择任务,唤醒时不重新放置),
+// 仅用于基准测试对比
+PRIVATE bool sched_eevdf = TRUE;
+
+PRIVATE bool task_is_rt(task_struct_t *task)
 {
-    uint64_t min_vrun_time     = vrun_time;
-    uint64_t cur_min_vrun_time = task_man->min_vrun_time;
+    return task->policy == SCHED_FIFO || task->policy == SCHED_RR;
+}
 
-    task_man->min_vrun_time = MAX_VRUNTIME(cur_min_vrun_time, min_vrun_time);
-    return;
+PRIVATE bool task_is_dl(task_struct_t *task)
+{
+    return task->policy == SCHED_DEADLINE;
+}
+
+PRIVATE bool task_is_fair(task_struct_t *task)
+{
+    return task->policy == SCHED_NORMAL;
+}
+
+PRIVATE uint64_t task_weight(task_struct_t *task)
+{
+    return task->se.weight;
+}
+
+PUBLIC uint64_t sched_prio_to_weight(uint64_t priority)
+{
+    // IDLE_PRIORITY超出了表的范围,idle不参与公平调度
+    return task_prio_to_weight[MIN(priority, IDLE_PRIORITY - 1)];
+}
+
+/**
+ * @brief 将实际时间换算为实体的虚拟时间
+ */
+PRIVATE uint64_t calc_delta_fair(uint64_t delta, sched_entity_t *se)
+{
+    return delta * task_prio_to_weight[DEFAULT_PRIORITY] / se->weight;
+}
+
+PRIVATE sched_entity_t *rq_node_to_se(rbtree_node_t *node)
+{
+    return CONTAINER_OF(sched_entity_t, rq_node, node);
 }
 
-PRIVATE void update_vrun_time(task_struct_t *task)
+PRIVATE task_struct_t *se_to_task(sched_entity_t *se)
 {
-    uint64_t nice0_weight = task_prio_to_weight[DEFAULT_PRIORITY];
-    uint64_t cur_weight   = task_prio_to_weight[task->priority];
+    return CONTAINER_OF(task_struct_t, se, se);
+}
 
-    uint64_t vrun_time     = task->run_time * nice0_weight / cur_weight;
-    uint64_t min_vrun_time = get_min_vrun_time(task->cpu_id);
+/**
+ * @brief 获取实体上一级的任务组实体,位于cpu的根队列中时返回NULL
+ */
+PRIVATE sched_entity_t *parent_entity(sched_entity_t *se)
+{
+    return se->cfs_rq->se;
+}
 
-    task->vrun_time = MAX_VRUNTIME(vrun_time, min_vrun_time);
+PRIVATE uint64_t min_vruntime(uint64_t a, uint64_t b)
+{
+    return (int64_t)(a - b) < 0 ? a : b;
+}
 
-    if (task->vrun_time != vrun_time)
+/**
+ * @brief 重新计算就绪队列节点的子树中最小的vrun_time
+ * @param node 实体的rq_node
+ * @note 作为cfs_rq的树的augment函数
+ */
+PRIVATE void cfs_tree_augment(rbtree_node_t *node)
+{
+    sched_entity_t *se       = rq_node_to_se(node);
+    uint64_t        min_vrun = se->vrun_time;
+    if (node->left != NULL)
+    {
+        min_vrun = min_vruntime(min_vrun, rq_node_to_se(node->left)->min_vrun);
+    }
+    if (node->right != NULL)
     {
-        // 如果task->vrun_time != vrun_time,表示当前vrun_time小于min_vrun_time,
-        // 需要对vrun_time进行调整,防止长时间占用cpu.
-        // 上文已经调整过vrun_time,此处调整run_time,使下次计算得到的vrun_time是正常值
-        task->run_time = task->vrun_time * cur_weight / nice0_weight;
+        min_vrun =
+            min_vruntime(min_vrun, rq_node_to_se(node->right)->min_vrun);
     }
-    task_man_t *task_man = get_task_man(task->cpu_id);
-    update_min_vrun_time(task_man, task->vrun_time);
+    se->min_vrun = min_vrun;
+    return;
+}
 
+PUBLIC void init_cfs_rq(cfs_rq_t *cfs, sched_entity_t *se)
+{
+    init_rbtree_augmented(&cfs->tree, cfs_tree_augment);
+    cfs->min_vrun_time = 0;
+    cfs->avg_vrun      = 0;
+    cfs->nr_queued     = 0;
+    cfs->load          = 0;
+    cfs->curr          = NULL;
+    cfs->se            = se;
     return;
 }
 
-PUBLIC uint64_t get_min_vrun_time(uint32_t cpu_id)
+/**
+ * @brief 获取计入平均vrun_time的正在运行的实体
+ * @note 正在运行的任务在切换出去前已被唤醒者放回树中时,不重复计入
+ */
+PRIVATE sched_entity_t *cfs_curr(cfs_rq_t *cfs)
 {
-    task_man_t *task_man = get_task_man(cpu_id);
-    return task_man->min_vrun_time;
+    sched_entity_t *curr = cfs->curr;
+    return curr != NULL && !curr->on_rq ? curr : NULL;
 }
 
-PUBLIC void task_update(void)
+/**
+ * @brief 计算队列中与正在运行的实体的Σ(vrun_time - min_vrun_time) * 权重
+ *        与总权重
+ */
+PRIVATE void avg_vrun_load(cfs_rq_t *cfs, int64_t *avg, uint64_t *load)
 {
-    ASSERT(intr_get_status() == INTR_OFF);
-    task_struct_t *cur_task = running_task();
-    cur_task->run_time++;
-    update_vrun_time(cur_task);
+    sched_entity_t *curr = cfs_curr(cfs);
+    *avg                 = cfs->avg_vrun;
+    *load                = cfs->load;
+    if (curr != NULL)
+    {
+        *avg += (int64_t)(curr->vrun_time - cfs->min_vrun_time) * curr->weight;
+        *load += curr->weight;
+    }
     return;
 }
 
-PRIVATE void inform_exit(pid_t exited_task)
+/**
+ * @brief 计算按权重平均的vrun_time(V)
+ * @note 需持有队列所属cpu的task_list_lock
+ */
+PRIVATE uint64_t avg_vrun_time(cfs_rq_t *cfs)
+{
+    int64_t  avg;
+    uint64_t load;
+    avg_vrun_load(cfs, &avg, &load);
+    if (load == 0)
+    {
+        return cfs->min_vrun_time;
+    }
+    return cfs->min_vrun_time + avg / (int64_t)load;
+}
+
+/**
+ * @brief 判断vrun_time是否合格(不大于平均vrun_time)
+ * @note 使用乘法比较,避免计算平均值时的截断误差
+ */
+PRIVATE bool vrun_eligible(cfs_rq_t *cfs, uint64_t vrun_time)
 {
-    task_struct_t *task        = pid_to_task(exited_task);
-    task_struct_t *parent_task = pid_to_task(task->ppid);
+    int64_t  avg;
+    uint64_t load;
+    avg_vrun_load(cfs, &avg, &load);
+    return (int64_t)(vrun_time - cfs->min_vrun_time) * (int64_t)load <= avg;
+}
 
-    spinlock_lock(&parent_task->child_list_lock);
-    list_append(&parent_task->exited_child_list, &task->general_tag);
-    spinlock_unlock(&parent_task->child_list_lock);
+PRIVATE void avg_vrun_add(cfs_rq_t *cfs, sched_entity_t *se)
+{
+    int64_t key = se->vrun_time - cfs->min_vrun_time;
+    cfs->avg_vrun += key * (int64_t)se->weight;
+    return;
+}
+
+PRIVATE void avg_vrun_sub(cfs_rq_t *cfs, sched_entity_t *se)
+{
+    int64_t key = se->vrun_time - cfs->min_vrun_time;
+    cfs->avg_vrun -= key * (int64_t)se->weight;
     return;
 }
 
 /**
- * @brief 检查waiting_list中是否有可以运行的任务
- * @param task_man
- * @return
+ * @brief 将min_vrun_time推进到队列中与正在运行的实体中最小的vrun_time
+ * @note 需持有队列所属cpu的task_list_lock.min_vrun_time只增不减
  */
-PRIVATE void check_waiting_list(task_man_t *task_man)
+PRIVATE void update_min_vrun_time(cfs_rq_t *cfs)
 {
-    if (list_empty(&task_man->waiting_list))
+    sched_entity_t *curr      = cfs_curr(cfs);
+    uint64_t        vrun_time = cfs->min_vrun_time;
+    rbtree_node_t  *root      = cfs->tree.root;
+    if (curr != NULL)
     {
-        return;
+        vrun_time = curr->vrun_time;
     }
-    list_node_t *node      = list_head(&task_man->waiting_list);
-    list_node_t *node_next = list_next(node);
-    do
+    if (root != NULL)
     {
-        node                = node_next;
-        node_next           = list_next(node);
-        task_struct_t *task = CONTAINER_OF(task_struct_t, general_tag, node);
-        task_status_t  stat = task->status;
-
-        int ipc_check        = task_ipc_check(task->pid);
-        int has_exited_child = task_has_exited_child(task->pid);
-        if ((stat == TASK_SENDING || stat == TASK_RECEIVING) && !ipc_check)
-        {
-            continue;
-        }
-        if (task->status == TASK_WAITING && !has_exited_child)
-        {
-            continue;
-        }
-        list_remove(node);
-        task_unblock(task->pid);
-    } while (node_next != list_tail(&task_man->waiting_list));
+        uint64_t min_vrun = rq_node_to_se(root)->min_vrun;
+        vrun_time = curr != NULL ? min_vruntime(vrun_time, min_vrun) : min_vrun;
+    }
+    int64_t delta = vrun_time - cfs->min_vrun_time;
+    if (delta > 0)
+    {
+        cfs->avg_vrun -= delta * (int64_t)cfs->load;
+        cfs->min_vrun_time = vrun_time;
+    }
     return;
 }
 
 /**
- * @brief 在列表中获取下一个可以运行的任务
- * @param task_man 任务管理结构
- * @return 成功将返回下一个任务结构,失败则返回NULL
+ * @brief 更新实体的vrun_time,已运行完请求的时间片时设置新的截止时间
+ * @return 时间片用完时返回TRUE
  */
-PRIVATE task_struct_t *get_next_task(task_man_t *task_man)
+PRIVATE bool update_vrun_time(sched_entity_t *se, uint64_t delta)
 {
-    list_t      *list = &task_man->task_list;
-    list_node_t *node = NULL;
-
-    if (!list_empty(list))
+    se->vrun_time += calc_delta_fair(delta, se);
+    if (!sched_eevdf)
     {
-        node = list_pop(list);
+        // vrun_time小于min_vrun_time时进行调整,防止长时间占用cpu
+        se->vrun_time = MAX_VRUNTIME(se->vrun_time, se->cfs_rq->min_vrun_time);
     }
-    else
+    if ((int64_t)(se->vrun_time - se->deadline) < 0)
     {
-        // 无任务可运行 - 唤醒idle
-        task_unblock_sub(task_man->idle_task->pid);
-        node = &task_man->idle_task->general_tag;
-        list_remove(node);
+        return FALSE;
     }
-    task_struct_t *next = CONTAINER_OF(task_struct_t, general_tag, node);
-    task_man->running_tasks--;
-    task_man->total_weight -= task_prio_to_weight[next->priority];
-    return next;
+    se->deadline = se->vrun_time + calc_delta_fair(se->slice, se);
+    return TRUE;
 }
 
-extern void ASMLINKAGE
-asm_switch_to(task_context_t **cur, task_context_t **next);
-
-PUBLIC void schedule(void)
+/**
+ * @brief 在实体加入队列前,根据vlag放置实体
+ * @param cfs 实体将加入的队列
+ * @param se 实体
+ * @note 需持有队列所属cpu的task_list_lock.
+ *       实体以离开时相对于平均vrun_time的差值回到队列,
+ *       长时间阻塞不会积累额外的优先权,也不会因旧的vrun_time而被推迟
+ */
+PRIVATE void place_entity(cfs_rq_t *cfs, sched_entity_t *se)
 {
-    task_struct_t *cur_task = running_task();
-    uint32_t       cpu_id   = cur_task->cpu_id;
-    task_man_t    *task_man = get_task_man(cpu_id);
+    se->vrun_time = avg_vrun_time(cfs) - se->vlag;
+    se->deadline  = se->vrun_time + calc_delta_fair(se->slice, se);
+    se->vlag      = 0;
+    se->cfs_rq    = cfs;
+    return;
+}
 
-    if (cur_task->preempt_count > 0)
+/**
+ * @brief 实体离开队列时记录vlag
+ * @param cfs 实体所在的队列
+ * @param se 离开的实体(仍是cfs->curr或仍在树中)
+ * @note 需持有队列所属cpu的task_list_lock
+ */
+PRIVATE void update_vlag(cfs_rq_t *cfs, sched_entity_t *se)
+{
+    uint64_t limit = calc_delta_fair(MAX(2 * se->slice, SCHED_MIN_LAG), se);
+    int64_t  lag   = avg_vrun_time(cfs) - se->vrun_time;
+    if (lag > (int64_t)limit)
     {
-        return;
+        lag = limit;
     }
-
-    intr_status_t intr_status = intr_disable();
-
-    switch (cur_task->status)
+    if (lag < -(int64_t)limit)
     {
-        case TASK_RUNNING:
-            spinlock_lock(&task_man->task_list_lock);
-            task_list_insert(task_man, cur_task);
-            spinlock_unlock(&task_man->task_list_lock);
-            break;
+        lag = -(int64_t)limit;
+    }
+    se->vlag = lag;
+    return;
+}
 
-        case TASK_SENDING:
-        case TASK_RECEIVING:
-        case TASK_WAITING:
-            list_append(&task_man->waiting_list, &cur_task->general_tag);
-            break;
+/**
+ * @brief 将实体的vrun_time从from换算到to,保持相对于平均vrun_time的差值
+ * @note 需持有两个队列所属cpu的task_list_lock.
+ *       各队列的vrun_time互不相关,迁移或更换任务组时使用
+ */
+PRIVATE void rebase_entity(sched_entity_t *se, cfs_rq_t *from, cfs_rq_t *to)
+{
+    uint64_t vrun_time = se->vrun_time;
+    int64_t  lag       = avg_vrun_time(from) - vrun_time;
+    se->vrun_time      = avg_vrun_time(to) - lag;
+    se->deadline += se->vrun_time - vrun_time;
+    se->cfs_rq = to;
+    return;
+}
 
-        case TASK_DIED:
-            inform_exit(cur_task->pid);
-            break;
+PRIVATE bool deadline_less(rbtree_node_t *a, rbtree_node_t *b)
+{
+    sched_entity_t *se_a = rq_node_to_se(a);
+    sched_entity_t *se_b = rq_node_to_se(b);
+    return (int64_t)(se_a->deadline - se_b->deadline) < 0;
+}
 
-        default:
-            break;
-    }
-    check_waiting_list(task_man);
+PRIVATE void enqueue_entity(cfs_rq_t *cfs, sched_entity_t *se)
+{
+    se->min_vrun = se->vrun_time;
+    se->cfs_rq   = cfs;
+    se->on_rq    = TRUE;
+    rbtree_insert(&cfs->tree, &se->rq_node, deadline_less);
+    avg_vrun_add(cfs, se);
+    cfs->nr_queued++;
+    cfs->load += se->weight;
+    return;
+}
 
-    task_struct_t *next = NULL;
+PRIVATE void dequeue_entity(cfs_rq_t *cfs, sched_entity_t *se)
+{
+    rbtree_remove(&cfs->tree, &se->rq_node);
+    avg_vrun_sub(cfs, se);
+    se->on_rq = FALSE;
+    cfs->nr_queued--;
+    cfs->load -= se->weight;
+    return;
+}
 
-    spinlock_lock(&task_man->task_list_lock);
-    next = get_next_task(task_man);
-    spinlock_unlock(&task_man->task_list_lock);
+/**
+ * @brief 修改实体的权重
+ * @note 需持有队列所属cpu的task_list_lock
+ */
+PRIVATE void reweight_entity(sched_entity_t *se, uint64_t weight)
+{
+    cfs_rq_t *cfs = se->cfs_rq;
+    if (!se->on_rq)
+    {
+        se->weight = weight;
+        return;
+    }
+    dequeue_entity(cfs, se);
+    se->weight = weight;
+    enqueue_entity(cfs, se);
+    return;
+}
 
-    next->status = TASK_RUNNING;
-    proc_activate(next);
-    asm_fxsave(cur_task->fxsave_region);
-    asm_fxrstor(next->fxsave_region);
-    next->cpu_id = cpu_id;
-    asm_switch_to(&cur_task->context, &next->context);
+PUBLIC uint64_t get_min_vrun_time(uint32_t cpu_id)
+{
+    task_man_t *task_man = get_task_man(cpu_id);
+    return task_man->cfs.min_vrun_time;
+}
 
-    intr_set_status(intr_status);
+PUBLIC void sched_set_eevdf(bool enable)
+{
+    sched_eevdf = enable;
     return;
 }
 
-PUBLIC void task_list_insert(task_man_t *task_man, task_struct_t *task)
+PUBLIC void task_account(task_struct_t *task, bool user)
 {
-    ASSERT(task_man != NULL);
-    list_t *list = &task_man->task_list;
-    if (list_find(list, &task->general_tag))
+    intr_status_t intr_status = intr_disable();
+
+    uint64_t now     = read_tsc();
+    uint64_t delta   = tsc_to_ns(now - task->exec_start);
+    task->exec_start = now;
+
+    if (user)
     {
-        PR_LOG(LOG_WARN, "this task is already in the list: %s.\n", task->name);
-        return;
+        task->user_time += delta;
+    }
+    else
+    {
+        task->kernel_time += delta;
     }
-    list_node_t   *node = list->head.next;
-    task_struct_t *tmp;
-    while (node != &list->tail)
+    task->run_time += delta;
+    task->slice_run_time += delta;
+    if (task_is_dl(task))
     {
-        tmp = CONTAINER_OF(task_struct_t, general_tag, node);
-        if ((int64_t)(task->vrun_time - tmp->vrun_time) < 0)
+        // 预算用完时重新调度,schedule()将任务放入限制队列
+        task->dl_budget -= (int64_t)delta;
+        if (task->dl_budget <= 0)
         {
-            break;
+            get_task_man(task->cpu_id)->need_resched = TRUE;
         }
-        node = list_next(node);
     }
-    list_in(&task->general_tag, node);
-    task_man->running_tasks++;
-    task_man->total_weight += task_prio_to_weight[task->priority];
-    task->status = TASK_READY;
+    else if (task_is_rt(task))
+    {
+        // 实时任务不参与vrun_time的计算,以免推高min_vrun_time
+        get_task_man(task->cpu_id)->rt_time += delta;
+        task->rt_slice_left -= MIN(delta, task->rt_slice_left);
+    }
+    else
+    {
+        // 依次更新任务与所属任务组的实体,
+        // 任一级的时间片用完且同一队列中有其他实体时重新选择(可能仍选中此任务)
+        task_man_t     *task_man = get_task_man(task->cpu_id);
+        sched_entity_t *se       = &task->se;
+        while (se != NULL && se->cfs_rq != NULL && se->cfs_rq->curr == se)
+        {
+            if (update_vrun_time(se, delta) && se->cfs_rq->nr_queued > 0)
+            {
+                task_man->need_resched = TRUE;
+            }
+            se = parent_entity(se);
+        }
+    }
+
+    intr_set_status(intr_status);
     return;
 }
 
-PUBLIC void task_block(task_status_t status)
+/**
+ * @brief 计算cpu的负载(就绪队列与正在运行的普通任务的总权重)
+ * @param task_man 任务管理结构
+ * @note 读取时不持锁,结果仅用于估计
+ */
+PRIVATE uint64_t cpu_load(task_man_t *task_man)
 {
-    intr_status_t  intr_status = intr_disable();
-    task_struct_t *cur_task    = running_task();
-    ASSERT(cur_task->preempt_count == 0);
-    cur_task->status = status;
-    schedule();
-    intr_set_status(intr_status);
-    return;
+    uint64_t       load = task_man->total_weight;
+    task_struct_t *curr = task_man->curr;
+    // 与total_weight一致,只计入普通任务的实体权重
+    if (curr != NULL && curr != task_man->idle_task && task_is_fair(curr))
+    {
+        load += task_weight(curr);
+    }
+    return load;
 }
 
-PUBLIC void task_unblock(pid_t pid)
+/**
+ * @brief 计算cpu上可运行的任务数量(包括正在运行的任务)
+ * @param task_man 任务管理结构
+ */
+PRIVATE uint64_t cpu_nr_running(task_man_t *task_man)
 {
-    intr_status_t intr_status = intr_disable();
+    uint64_t       nr   = task_man->running_tasks;
+    task_struct_t *curr = task_man->curr;
+    if (curr != NULL && curr != task_man->idle_task)
+    {
+        nr++;
+    }
+    return nr;
+}
 
-    task_struct_t *task     = pid_to_task(pid);
-    task_man_t    *task_man = get_task_man(task->cpu_id);
+// PELT: y^n * 2^32 (0 <= n < 32)
+PRIVATE const uint32_t pelt_y_inv[32] = {
+    0xffffffff, 0xfa83b2da, 0xf5257d14, 0xefe4b99a, 0xeac0c6e6, 0xe5b906e6,
+    0xe0ccdeeb, 0xdbfbb796, 0xd744fcc9, 0xd2a81d91, 0xce248c14, 0xc9b9bd85,
+    0xc5672a10, 0xc12c4cc9, 0xbd08a39e, 0xb8fbaf46, 0xb504f333, 0xb123f581,
+    0xad583ee9, 0xa9a15ab4, 0xa5fed6a9, 0xa2704302, 0x9ef5325f, 0x9b8d39b9,
+    0x9837f050, 0x94f3efe1, 0x91c3d373, 0x8ea4398a, 0x8b95c1e3, 0x88980e80,
+    0x85aac367, 0x82cd8698,
+};
 
-    spinlock_lock(&task_man->task_list_lock);
-    task_unblock_sub(pid);
-    spinlock_unlock(&task_man->task_list_lock);
+/**
+ * @brief 计算val经过n个周期衰减后的值(val * y^n)
+ */
+PRIVATE uint64_t pelt_decay(uint64_t val, uint64_t n)
+{
+    if (n >= 32 * 64)
+    {
+        return 0;
+    }
+    val >>= n / 32;
+    return (uint64_t)(((unsigned __int128)val * pelt_y_inv[n % 32]) >> 32);
+}
 
-    intr_set_status(intr_status);
+/**
+ * @brief 将负载跟踪数据更新到now
+ * @param sa 负载跟踪数据
+ * @param now 当前时刻(ns)
+ * @param load 上一次更新以来可运行时的权重(不可运行时为0)
+ * @param runnable 上一次更新以来可运行的任务数 * UTIL_SCALE
+ * @param running 上一次更新以来正在运行时为UTIL_SCALE,否则为0
+ * @note 上一次更新以来的状态视为不变,因此需在状态改变前调用
+ */
+PRIVATE void pelt_update(
+    sched_avg_t *sa,
+    uint64_t     now,
+    uint64_t     load,
+    uint64_t     runnable,
+    uint64_t     running
+)
+{
+    now >>= 10;
+    if (sa->last_update == 0)
+    {
+        sa->last_update = now;
+        return;
+    }
+    if ((int64_t)(now - sa->last_update) <= 0)
+    {
+        return;
+    }
+    uint64_t delta   = now - sa->last_update;
+    uint64_t contrib = delta;
+    uint64_t periods = (sa->period_contrib + delta) / PELT_PERIOD;
+    sa->last_update  = now;
+    if (periods > 0)
+    {
+        // 贡献分为三段: 补齐上一个未满的周期(d1),中间的完整周期(d2),
+        // 当前未满的周期(d3),d2 = 1024 * Σ y^n (1 <= n < periods)
+        uint64_t d1 = PELT_PERIOD - sa->period_contrib;
+        uint64_t d2 = PELT_LOAD_MAX - pelt_decay(PELT_LOAD_MAX, periods);
+        uint64_t d3 = (sa->period_contrib + delta) % PELT_PERIOD;
+        d2 -= PELT_PERIOD;
+
+        sa->load_sum       = pelt_decay(sa->load_sum, periods);
+        sa->runnable_sum   = pelt_decay(sa->runnable_sum, periods);
+        sa->util_sum       = pelt_decay(sa->util_sum, periods);
+        sa->period_contrib = d3;
+        contrib            = pelt_decay(d1, periods) + d2 + d3;
+    }
+    else
+    {
+        sa->period_contrib += delta;
+    }
+    sa->load_sum += load * contrib;
+    sa->runnable_sum += runnable * contrib;
+    sa->util_sum += running * contrib;
+
+    uint64_t divider = PELT_LOAD_MAX - PELT_PERIOD + sa->period_contrib;
+    sa->load_avg     = sa->load_sum / divider;
+    sa->runnable_avg = sa->runnable_sum / divider;
+    sa->util_avg     = sa->util_sum / divider;
     return;
 }
 
-PUBLIC void task_unblock_sub(pid_t pid)
+/**
+ * @brief 更新任务的负载跟踪数据
+ * @param task_man 任务所在cpu的任务管理结构
+ * @param task 任务
+ * @note 需持有task_man->task_list_lock,在任务入队、出队与切换前调用
+ */
+PRIVATE void update_task_avg(task_man_t *task_man, task_struct_t *task)
 {
-    task_struct_t *task     = pid_to_task(pid);
-    task_man_t    *task_man = get_task_man(task->cpu_id);
-    ASSERT(task != NULL);
-    task_list_insert(task_man, task);
+    if (task == task_man->idle_task)
+    {
+        return;
+    }
+    bool running  = task_man->curr == task;
+    bool runnable = running || (task->on_rq && !task->dl_throttled);
+    pelt_update(
+        &task->avg,
+        tsc_to_ns(read_tsc()),
+        runnable ? task_weight(task) : 0,
+        runnable ? UTIL_SCALE : 0,
+        running ? UTIL_SCALE : 0
+    );
     return;
 }
 
-PUBLIC void task_yield(void)
+/**
+ * @brief 更新cpu的负载跟踪数据
+ * @param task_man 任务管理结构
+ * @note 需持有task_man->task_list_lock,在就绪队列或正在运行的任务改变前调用
+ */
+PRIVATE void update_cpu_avg(task_man_t *task_man)
 {
-    intr_status_t intr_status = intr_disable();
-    schedule();
-    intr_set_status(intr_status);
+    uint64_t nr =
+        cpu_nr_running(task_man) + task_man->rt_running + task_man->dl_running;
+    pelt_update(
+        &task_man->avg,
+        tsc_to_ns(read_tsc()),
+        cpu_load(task_man),
+        nr * UTIL_SCALE,
+        task_man->curr != task_man->idle_task ? UTIL_SCALE : 0
+    );
     return;
 }
 
-PUBLIC void task_msleep(uint32_t milliseconds)
+PRIVATE bool dl_deadline_less(rbtree_node_t *a, rbtree_node_t *b)
 {
-    uint32_t timeout_tick = get_current_ticks() + MS_TO_TICKS(milliseconds);
+    task_struct_t *task_a = CONTAINER_OF(task_struct_t, dl_node, a);
+    task_struct_t *task_b = CONTAINER_OF(task_struct_t, dl_node, b);
+    return (int64_t)(task_a->dl_abs_deadline - task_b->dl_abs_deadline) < 0;
+}
 
-    while ((int64_t)(get_current_ticks() - timeout_tick) < 0)
-    {
-        task_yield();
-    }
-    return;
-}
\ No newline at end of file
+/**
+ * @brief 获取deadline任务下一个周期开始的时刻(ns)
+ */
+PRIVATE uint64_t dl_next_period(task_struct_t *task)
+{
+    return task->dl_abs_deadline - task->dl_deadline + task->dl_period;
+}
+
+PRIVATE bool dl_period_less(rbtree_node_t *a, rbtree_node_t *b)
+{
+    task_struct_t *task_a = CONTAINER_OF(task_struct_t, dl_node, a);
+    task_struct_t *task_b = CONTAINER_OF(task_struct_t, dl_node, b);
+    return (int64_t)(dl_next_period(task_a) - dl_next_period(task_b)) < 0;
+}
+
+/**
+ * @brief 预算用完的deadline任务进入下一个周期,补充预算并推迟截止时间
+ * @param task deadline任务
+ * @param now 当前时刻(ns)
+ * @note 超出预算的部分从新的预算中扣除.
+ *       截止时间仍早于当前时刻时,从当前时刻开始新的周期
+ */
+PRIVATE void dl_replenish(task_struct_t *task, uint64_t now)
+{
+    while (task->dl_budget <= 0)
+    {
+        task->dl_abs_deadline += task->dl_period;
+        task->dl_budget += (int64_t)task->dl_runtime;
+    }
+    if ((int64_t)(task->dl_abs_deadline - now) < 0)
+    {
+        task->dl_abs_deadline = now + task->dl_deadline;
+        task->dl_budget       = (int64_t)task->dl_runtime;
+    }
+    return;
+}
+
+/**
+ * @brief 被唤醒的deadline任务按CBS的规则决定是否开始新的周期
+ * @param task 被唤醒的deadline任务
+ * @note 剩余的预算在截止时间之前运行完不会超出任务的带宽时保留,
+ *       否则从当前时刻开始新的周期,防止任务通过阻塞积累带宽.
+ *       预算已用完且下一个周期尚未开始的任务在入队时被限制
+ */
+PRIVATE void dl_wakeup(task_struct_t *task)
+{
+    uint64_t now  = tsc_to_ns(read_tsc());
+    int64_t  left = (int64_t)(task->dl_abs_deadline - now);
+    // budget / left > runtime / deadline
+    bool overflow = task->dl_budget > 0 &&
+                    ((uint64_t)task->dl_budget << DL_BW_SHIFT) >
+                        (uint64_t)left * task->dl_bw;
+    if (left <= 0 || overflow)
+    {
+        task->dl_abs_deadline = now + task->dl_deadline;
+        task->dl_budget       = (int64_t)task->dl_runtime;
+    }
+    return;
+}
+
+/**
+ * @brief 将deadline任务加入就绪队列,预算已用完时加入限制队列
+ * @note 需持有task_man->task_list_lock
+ */
+PRIVATE void enqueue_task_dl(task_man_t *task_man, task_struct_t *task)
+{
+    if (task->dl_budget <= 0)
+    {
+        uint64_t now = tsc_to_ns(read_tsc());
+        if ((int64_t)(dl_next_period(task) - now) > 0)
+        {
+            // 由时钟中断在下一个周期开始时补充预算
+            task->dl_throttled = TRUE;
+            rbtree_insert(
+                &task_man->dl_throttle_tree,
+                &task->dl_node,
+                dl_period_less
+            );
+            task_man->dl_nr_throttled++;
+            return;
+        }
+        dl_replenish(task, now);
+    }
+    rbtree_insert(&task_man->dl_tree, &task->dl_node, dl_deadline_less);
+    task_man->dl_running++;
+    return;
+}
+
+/**
+ * @brief 将deadline任务移出就绪队列或限制队列
+ * @note 需持有task_man->task_list_lock
+ */
+PRIVATE void dequeue_task_dl(task_man_t *task_man, task_struct_t *task)
+{
+    if (task->dl_throttled)
+    {
+        rbtree_remove(&task_man->dl_throttle_tree, &task->dl_node);
+        task_man->dl_nr_throttled--;
+        task->dl_throttled = FALSE;
+        return;
+    }
+    rbtree_remove(&task_man->dl_tree, &task->dl_node);
+    task_man->dl_running--;
+    return;
+}
+
+/**
+ * @brief 判断就绪的deadline任务是否应当抢占正在运行的任务
+ * @note 只能抢占其他调度类的任务与截止时间更晚的deadline任务
+ */
+PRIVATE bool dl_preempt(task_struct_t *task, task_struct_t *curr)
+{
+    return !task_is_dl(curr) ||
+           (int64_t)(task->dl_abs_deadline - curr->dl_abs_deadline) < 0;
+}
+
+/**
+ * @brief 补充已到下一个周期的被限制的deadline任务的预算,并放回就绪队列
+ * @param task_man 当前cpu的任务管理结构
+ * @note 在时钟中断中调用,需持有task_man->task_list_lock
+ */
+PRIVATE void update_dl_throttled(task_man_t *task_man)
+{
+    uint64_t       now = tsc_to_ns(read_tsc());
+    rbtree_node_t *node;
+    while ((node = rbtree_first(&task_man->dl_throttle_tree)) != NULL)
+    {
+        task_struct_t *task = CONTAINER_OF(task_struct_t, dl_node, node);
+        if ((int64_t)(dl_next_period(task) - now) > 0)
+        {
+            break;
+        }
+        update_task_avg(task_man, task);
+        update_cpu_avg(task_man);
+        dequeue_task_dl(task_man, task);
+        dl_replenish(task, now);
+        enqueue_task_dl(task_man, task);
+        if (dl_preempt(task, task_man->curr))
+        {
+            task_man->need_resched = TRUE;
+        }
+    }
+    return;
+}
+
+/**
+ * @brief 更新实时任务的带宽控制状态
+ * @param task_man 当前cpu的任务管理结构
+ * @note 在时钟中断中调用
+ */
+PRIVATE void update_rt_bandwidth(task_man_t *task_man)
+{
+    uint64_t now = tsc_to_ns(read_tsc());
+    if (now - task_man->rt_period_start >= RT_PERIOD)
+    {
+        // 新的周期,恢复被限制的实时任务
+        task_man->rt_period_start = now;
+        task_man->rt_time         = 0;
+        if (task_man->rt_throttled)
+        {
+            task_man->rt_throttled = FALSE;
+            task_man->need_resched = task_man->rt_bitmap != 0;
+        }
+        return;
+    }
+    if (!task_man->rt_throttled && task_man->rt_time > RT_RUNTIME)
+    {
+        task_man->rt_throttled = TRUE;
+    }
+    return;
+}
+
+/**
+ * @brief 时钟中断中检查正在运行的实时任务是否需要让出cpu
+ * @param task_man 当前cpu的任务管理结构
+ * @param cur_task 正在运行的实时任务
+ */
+PRIVATE void task_update_rt(task_man_t *task_man, task_struct_t *cur_task)
+{
+    // 配额用完,让普通任务运行
+    if (task_man->rt_throttled && !rbtree_empty(&task_man->cfs.tree))
+    {
+        task_man->need_resched = TRUE;
+        return;
+    }
+    if (cur_task->policy != SCHED_RR || cur_task->rt_slice_left > 0)
+    {
+        return;
+    }
+    // 时间片用完,有同优先级的任务时轮转,否则继续运行
+    if (list_empty(&task_man->rt_queue[cur_task->rt_priority]))
+    {
+        cur_task->rt_slice_left = RT_RR_TIMESLICE;
+        return;
+    }
+    task_man->need_resched = TRUE;
+    return;
+}
+
+PUBLIC void task_update(void)
+{
+    ASSERT(intr_get_status() == INTR_OFF);
+    task_struct_t *cur_task = running_task();
+    task_man_t    *task_man = get_task_man(cur_task->cpu_id);
+    task_account(cur_task, FALSE);
+    update_rt_bandwidth(task_man);
+
+    spinlock_lock(&task_man->task_list_lock);
+    update_task_avg(task_man, cur_task);
+    update_cpu_avg(task_man);
+    update_dl_throttled(task_man);
+    spinlock_unlock(&task_man->task_list_lock);
+
+    if (cur_task == task_man->idle_task)
+    {
+        // idle运行期间进行负载均衡
+        task_man->need_resched = TRUE;
+        return;
+    }
+    // deadline任务的预算由task_account检查,抢占由update_dl_throttled检查
+    if (task_is_dl(cur_task))
+    {
+        return;
+    }
+    if (task_is_rt(cur_task))
+    {
+        task_update_rt(task_man, cur_task);
+        return;
+    }
+    // 有可以运行的deadline或实时任务
+    if (task_man->dl_running != 0 ||
+        (task_man->rt_bitmap != 0 && !task_man->rt_throttled))
+    {
+        task_man->need_resched = TRUE;
+        return;
+    }
+    // 时间片由task_account根据截止时间检查,此处只推进各级队列的min_vrun_time
+    spinlock_lock(&task_man->task_list_lock);
+    sched_entity_t *se = &cur_task->se;
+    while (se != NULL && se->cfs_rq != NULL && se->cfs_rq->curr == se)
+    {
+        update_min_vrun_time(se->cfs_rq);
+        se = parent_entity(se);
+    }
+    spinlock_unlock(&task_man->task_list_lock);
+    return;
+}
+
+PRIVATE void inform_exit(pid_t exited_task)
+{
+    task_struct_t *task = pid_to_task(exited_task);
+    task_struct_t *parent_task;
+
+    // 父任务可能同时退出并将task交给main_task,加锁后需确认ppid未改变
+    while (1)
+    {
+        parent_task = pid_to_task(task->ppid);
+        spinlock_lock(&parent_task->child_list_lock);
+        if (task->ppid == parent_task->pid)
+        {
+            break;
+        }
+        spinlock_unlock(&parent_task->child_list_lock);
+    }
+    list_append(&parent_task->exited_child_list, &task->general_tag);
+    spinlock_unlock(&parent_task->child_list_lock);
+    task_wakeup(parent_task, TASK_WAITING);
+    return;
+}
+
+/**
+ * @brief 获取任务在cpu上应加入的公平调度队列
+ * @param task_man 任务管理结构
+ * @param task 任务
+ */
+PRIVATE cfs_rq_t *task_cfs_rq(task_man_t *task_man, task_struct_t *task);
+
+/**
+ * @brief 将普通任务加入公平调度队列
+ * @note 需持有task_man->task_list_lock.
+ *       任务组的队列由空变为非空时,任务组的实体加入上一级队列
+ */
+PRIVATE void enqueue_task_fair(task_man_t *task_man, task_struct_t *task)
+{
+    cfs_rq_t       *cfs = task_cfs_rq(task_man, task);
+    sched_entity_t *se  = &task->se;
+
+    // 任务在运行或就绪期间更换了任务组
+    if (se->cfs_rq != NULL && se->cfs_rq != cfs)
+    {
+        rebase_entity(se, se->cfs_rq, cfs);
+    }
+    enqueue_entity(cfs, se);
+    while ((se = cfs->se) != NULL && !se->on_rq && se->cfs_rq->curr != se)
+    {
+        cfs = se->cfs_rq;
+        place_entity(cfs, se);
+        enqueue_entity(cfs, se);
+    }
+    task_man->running_tasks++;
+    task_man->total_weight += task_weight(task);
+    return;
+}
+
+/**
+ * @brief 将在队列中的普通任务移出公平调度队列
+ * @note 需持有task_man->task_list_lock.
+ *       任务组的队列变为空且组内没有正在运行的任务时,
+ *       任务组的实体记录vlag后离开上一级队列
+ */
+PRIVATE void dequeue_task_fair(task_man_t *task_man, task_struct_t *task)
+{
+    sched_entity_t *se  = &task->se;
+    cfs_rq_t       *cfs = se->cfs_rq;
+
+    dequeue_entity(cfs, se);
+    while ((se = cfs->se) != NULL && se->on_rq && cfs->nr_queued == 0 &&
+           cfs->curr == NULL)
+    {
+        cfs = se->cfs_rq;
+        update_vlag(cfs, se);
+        dequeue_entity(cfs, se);
+    }
+    task_man->running_tasks--;
+    task_man->total_weight -= task_weight(task);
+    return;
+}
+
+/**
+ * @brief 正在运行的任务让出cpu时,清除各级队列的curr
+ * @param task_man 任务管理结构
+ * @param prev 让出cpu的任务
+ * @note 需持有task_man->task_list_lock.任务不再运行时记录vlag.
+ *       任务组的队列中还有就绪的实体时,任务组的实体放回上一级队列,
+ *       否则记录vlag后离开
+ */
+PRIVATE void put_prev_fair(task_man_t *task_man, task_struct_t *prev)
+{
+    sched_entity_t *se  = &prev->se;
+    cfs_rq_t       *cfs = se->cfs_rq;
+    if (prev == task_man->idle_task || cfs == NULL || cfs->curr != se)
+    {
+        return;
+    }
+    if (prev->status != TASK_RUNNING && !se->on_rq)
+    {
+        update_vlag(cfs, se);
+    }
+    cfs->curr = NULL;
+    while ((se = cfs->se) != NULL)
+    {
+        cfs_rq_t *parent = se->cfs_rq;
+        if (cfs->nr_queued > 0)
+        {
+            parent->curr = NULL;
+            enqueue_entity(parent, se);
+        }
+        else
+        {
+            update_vlag(parent, se);
+            parent->curr = NULL;
+        }
+        cfs = parent;
+    }
+    return;
+}
+
+/**
+ * @brief 在合格的实体中选择截止时间最早的实体
+ * @param cfs 公平调度队列
+ * @return 选中的节点,队列为空时返回NULL
+ * @note 树按截止时间排序,子树中最小的vrun_time合格时,
+ *       该子树中必然有合格的实体,因此只需沿一条路径向下查找
+ */
+PRIVATE rbtree_node_t *pick_eevdf(cfs_rq_t *cfs)
+{
+    rbtree_node_t *node = cfs->tree.root;
+    while (node != NULL)
+    {
+        rbtree_node_t *left = node->left;
+        if (left != NULL && vrun_eligible(cfs, rq_node_to_se(left)->min_vrun))
+        {
+            node = left;
+            continue;
+        }
+        if (vrun_eligible(cfs, rq_node_to_se(node)->vrun_time))
+        {
+            return node;
+        }
+        node = node->right;
+    }
+    // 计算误差导致没有合格的实体时,选择截止时间最早的实体
+    return rbtree_first(&cfs->tree);
+}
+
+/**
+ * @brief 选择vrun_time最小的实体(关闭EEVDF时使用)
+ * @param cfs 公平调度队列
+ * @return 选中的节点,队列为空时返回NULL
+ */
+PRIVATE rbtree_node_t *pick_min_vrun(cfs_rq_t *cfs)
+{
+    rbtree_node_t *node = cfs->tree.root;
+    while (node != NULL)
+    {
+        uint64_t       min_vrun = rq_node_to_se(node)->min_vrun;
+        rbtree_node_t *left     = node->left;
+        if (left != NULL && rq_node_to_se(left)->min_vrun == min_vrun)
+        {
+            node = left;
+            continue;
+        }
+        if (rq_node_to_se(node)->vrun_time == min_vrun)
+        {
+            return node;
+        }
+        node = node->right;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 从根队列开始逐级选择实体,直到选中一个任务
+ * @param task_man 任务管理结构
+ * @return 选中的任务(仍在队列中),根队列为空时返回NULL
+ * @note 需持有task_man->task_list_lock.
+ *       选中的任务组实体离开树并成为所在队列的curr
+ */
+PRIVATE task_struct_t *pick_next_fair(task_man_t *task_man)
+{
+    cfs_rq_t *cfs = &task_man->cfs;
+    while (1)
+    {
+        update_min_vrun_time(cfs);
+        rbtree_node_t *node;
+        node = sched_eevdf ? pick_eevdf(cfs) : pick_min_vrun(cfs);
+        if (node == NULL)
+        {
+            // 任务组的实体在上一级队列中时,任务组的队列不为空
+            ASSERT(cfs->se == NULL);
+            return NULL;
+        }
+        sched_entity_t *se = rq_node_to_se(node);
+        if (se->my_q == NULL)
+        {
+            return se_to_task(se);
+        }
+        dequeue_entity(cfs, se);
+        cfs->curr = se;
+        cfs       = se->my_q;
+    }
+}
+
+/**
+ * @brief 将任务上一次状态变化以来的时间计入原状态,并开始为新状态计时
+ * @param task 任务
+ * @param status 新状态
+ * @param now 当前的TSC值
+ */
+PRIVATE void
+stat_set_status(task_struct_t *task, task_status_t status, uint64_t now)
+{
+    uint64_t delta = tsc_to_ns(now - task->stat_status_start);
+    task->sched_stat.status_time[task->stat_status] += delta;
+    task->stat_status       = status;
+    task->stat_status_start = now;
+    return;
+}
+
+/**
+ * @brief 将任务从就绪队列中移除
+ * @param task_man 任务管理结构
+ * @param task 要移除的任务结构体指针
+ */
+PRIVATE void task_list_remove(task_man_t *task_man, task_struct_t *task)
+{
+    update_task_avg(task_man, task);
+    update_cpu_avg(task_man);
+    if (task_is_dl(task))
+    {
+        dequeue_task_dl(task_man, task);
+    }
+    else if (task_is_rt(task))
+    {
+        uint32_t prio = task->rt_priority;
+        list_remove(&task->rt_tag);
+        if (list_empty(&task_man->rt_queue[prio]))
+        {
+            task_man->rt_bitmap &= ~(1U << prio);
+        }
+        task_man->rt_running--;
+    }
+    else
+    {
+        dequeue_task_fair(task_man, task);
+    }
+    task->on_rq = FALSE;
+    task->wait_time += tsc_to_ns(read_tsc() - task->wait_start);
+    return;
+}
+
+PUBLIC bool task_list_empty(task_man_t *task_man)
+{
+    return task_man->dl_running == 0 && task_man->rt_running == 0 &&
+           rbtree_empty(&task_man->cfs.tree);
+}
+
+/**
+ * @brief 在就绪队列中获取下一个可以运行的任务
+ * @param task_man 任务管理结构
+ * @return 下一个任务结构,优先选择绝对截止时间最早的deadline任务,
+ *         其次是优先级最高的实时任务,
+ *         最后逐级在合格的实体中选择截止时间最早的实体,
+ *         就绪队列为空时返回idle任务
+ * @note 实时任务被限制时,只在没有普通任务可以运行时运行
+ */
+PRIVATE task_struct_t *get_next_task(task_man_t *task_man)
+{
+    rbtree_node_t *dl_node = rbtree_first(&task_man->dl_tree);
+    if (dl_node != NULL)
+    {
+        task_struct_t *next = CONTAINER_OF(task_struct_t, dl_node, dl_node);
+        task_list_remove(task_man, next);
+        return next;
+    }
+    if (task_man->rt_bitmap != 0 &&
+        (!task_man->rt_throttled || rbtree_empty(&task_man->cfs.tree)))
+    {
+        uint32_t       prio = 31 - __builtin_clz(task_man->rt_bitmap);
+        list_node_t   *head = list_head(&task_man->rt_queue[prio]);
+        task_struct_t *next = CONTAINER_OF(task_struct_t, rt_tag, head->next);
+        task_list_remove(task_man, next);
+        return next;
+    }
+    task_struct_t *next = pick_next_fair(task_man);
+    if (next == NULL)
+    {
+        // 无任务可运行 - 运行idle
+        return task_man->idle_task;
+    }
+    task_list_remove(task_man, next);
+    next->se.cfs_rq->curr = &next->se;
+    return next;
+}
+
+/**
+ * @brief 按cpu id的顺序获取两个cpu的task_list_lock,防止死锁
+ */
+PRIVATE void double_lock(task_man_t *a, task_man_t *b)
+{
+    if (a->cpu_id < b->cpu_id)
+    {
+        spinlock_lock(&a->task_list_lock);
+        spinlock_lock(&b->task_list_lock);
+    }
+    else
+    {
+        spinlock_lock(&b->task_list_lock);
+        spinlock_lock(&a->task_list_lock);
+    }
+    return;
+}
+
+PRIVATE void double_unlock(task_man_t *a, task_man_t *b)
+{
+    spinlock_unlock(&a->task_list_lock);
+    spinlock_unlock(&b->task_list_lock);
+    return;
+}
+
+/**
+ * @brief 将任务从src迁移到dst的就绪队列
+ * @param task 要迁移的任务(必须在src的就绪队列中,且不在cpu上运行)
+ * @param src 源cpu
+ * @param dst 目标cpu
+ * @note 调用前需要获取src与dst的task_list_lock
+ */
+PRIVATE void migrate_task(task_struct_t *task, task_man_t *src, task_man_t *dst)
+{
+    cfs_rq_t *from = task->se.cfs_rq;
+    task_list_remove(src, task);
+
+    // 迁移时保留任务相对于源队列的平均vrun_time的差值,再换算到目标队列上
+    task->cpu_id = dst->cpu_id;
+    if (task_is_fair(task))
+    {
+        rebase_entity(&task->se, from, task_cfs_rq(dst, task));
+    }
+
+    task_list_insert(dst, task);
+    return;
+}
+
+/**
+ * @brief 从src的公平调度队列cfs(及其中任务组的队列)中拉取任务到dst
+ * @param dst 目标cpu
+ * @param src 源cpu
+ * @param cfs src上的公平调度队列
+ * @param imbalance 允许迁移的最大总权重,返回时减去已迁移的权重
+ * @param max_move 最多迁移的任务数,返回时减去已迁移的任务数
+ * @note 调用前需要获取src与dst的task_list_lock
+ */
+PRIVATE void pull_from_cfs(
+    task_man_t *dst,
+    task_man_t *src,
+    cfs_rq_t   *cfs,
+    uint64_t   *imbalance,
+    int        *max_move
+)
+{
+    rbtree_node_t *node = rbtree_first(&cfs->tree);
+    rbtree_node_t *next;
+    while (node != NULL && *max_move > 0)
+    {
+        // 迁移可能使任务组的实体离开cfs,需提前获取下一个节点
+        next               = rbtree_next(node);
+        sched_entity_t *se = rq_node_to_se(node);
+        if (se->my_q != NULL)
+        {
+            pull_from_cfs(dst, src, se->my_q, imbalance, max_move);
+            node = next;
+            continue;
+        }
+        task_struct_t *task = se_to_task(se);
+        uint64_t       w    = task_weight(task);
+
+        // 正在运行(或尚未完成切换)的任务与idle不能迁移
+        if (task != src->idle_task && !task->on_cpu && w <= *imbalance &&
+            CPUMASK_TEST(&task->cpus_allowed, dst->cpu_id))
+        {
+            migrate_task(task, src, dst);
+            *imbalance -= w;
+            (*max_move)--;
+        }
+        node = next;
+    }
+    return;
+}
+
+/**
+ * @brief 从src的就绪队列中拉取任务到dst
+ * @param dst 目标cpu
+ * @param src 源cpu
+ * @param imbalance 允许迁移的最大总权重
+ * @param max_move 最多迁移的任务数
+ * @note 调用前需要获取src与dst的task_list_lock
+ */
+PRIVATE void pull_tasks(
+    task_man_t *dst,
+    task_man_t *src,
+    uint64_t    imbalance,
+    int         max_move
+)
+{
+    pull_from_cfs(dst, src, &src->cfs, &imbalance, &max_move);
+    return;
+}
+
+/**
+ * @brief 寻找负载最重的cpu
+ * @param this_man 当前cpu
+ * @param this_load 当前cpu的负载
+ * @return 负载最重且有任务可迁移的cpu,没有比当前cpu更重的则返回NULL
+ */
+PRIVATE task_man_t *find_busiest_cpu(task_man_t *this_man, uint64_t this_load)
+{
+    task_man_t *busiest  = NULL;
+    uint64_t    max_load = this_load;
+    int         i;
+    for (i = 0; i < apic.number_of_cores; i++)
+    {
+        task_man_t *task_man = get_task_man(apic.lapic_id[i]);
+        // 跳过自身与尚未启动的cpu
+        if (task_man == this_man || task_man->idle_task == NULL)
+        {
+            continue;
+        }
+        if (task_man->running_tasks == 0 || cpu_nr_running(task_man) < 2)
+        {
+            continue;
+        }
+        uint64_t load = cpu_load(task_man);
+        if (load > max_load)
+        {
+            max_load = load;
+            busiest  = task_man;
+        }
+    }
+    return busiest;
+}
+
+/**
+ * @brief 负载均衡,从负载最重的cpu拉取任务到当前cpu
+ * @param this_man 当前cpu的任务管理结构
+ * @param idle 当前cpu是否即将空闲(就绪队列为空)
+ * @note 空闲时只拉取一个任务(工作窃取),否则按权重差拉取任务使负载趋于平衡.
+ *       调用时当前任务已经放回就绪队列或已阻塞,因此当前cpu的负载即total_weight
+ */
+PRIVATE void load_balance(task_man_t *this_man, bool idle)
+{
+    task_man_t *busiest = find_busiest_cpu(this_man, this_man->total_weight);
+    if (busiest == NULL)
+    {
+        return;
+    }
+
+    double_lock(this_man, busiest);
+    uint64_t this_load    = this_man->total_weight;
+    uint64_t busiest_load = cpu_load(busiest);
+    if (busiest_load > this_load && cpu_nr_running(busiest) >= 2)
+    {
+        if (idle)
+        {
+            pull_tasks(this_man, busiest, busiest_load, 1);
+        }
+        else
+        {
+            uint64_t imbalance = (busiest_load - this_load) / 2;
+            pull_tasks(this_man, busiest, imbalance, LOAD_BALANCE_MAX_MOVE);
+        }
+    }
+    double_unlock(this_man, busiest);
+    return;
+}
+
+PRIVATE void
+task_list_enqueue(task_man_t *task_man, task_struct_t *task, bool head);
+
+PRIVATE bool check_preempt_wakeup(task_man_t *task_man, task_struct_t *task);
+
+/**
+ * @brief 判断cpu a的负载是否比b轻
+ * @note 依次比较可运行的任务数(包括deadline与实时任务)、总权重与利用率
+ */
+PRIVATE bool cpu_lighter(task_man_t *a, task_man_t *b)
+{
+    uint64_t nr_a = cpu_nr_running(a) + a->rt_running + a->dl_running;
+    uint64_t nr_b = cpu_nr_running(b) + b->rt_running + b->dl_running;
+    if (nr_a != nr_b)
+    {
+        return nr_a < nr_b;
+    }
+    uint64_t load_a = cpu_load(a);
+    uint64_t load_b = cpu_load(b);
+    if (load_a != load_b)
+    {
+        return load_a < load_b;
+    }
+    return a->avg.util_avg < b->avg.util_avg;
+}
+
+/**
+ * @brief 在任务允许运行的已启动的cpu中选择负载最轻的cpu
+ * @param task 任务
+ * @param prev 任务上一次运行的cpu(可以为NULL),空闲时直接选择以利用缓存
+ * @return 选中的cpu,没有可用的cpu时返回NULL
+ * @note 读取时不持锁,结果仅用于估计
+ */
+PRIVATE task_man_t *select_task_cpu(task_struct_t *task, task_man_t *prev)
+{
+    if (prev != NULL && CPUMASK_TEST(&task->cpus_allowed, prev->cpu_id) &&
+        cpu_nr_running(prev) + prev->rt_running + prev->dl_running == 0)
+    {
+        return prev;
+    }
+    task_man_t *best = NULL;
+    int         i;
+    for (i = 0; i < apic.number_of_cores; i++)
+    {
+        task_man_t *task_man = get_task_man(apic.lapic_id[i]);
+        if (task_man->idle_task == NULL ||
+            !CPUMASK_TEST(&task->cpus_allowed, task_man->cpu_id))
+        {
+            continue;
+        }
+        // 负载相同时优先选择prev
+        if (best == NULL || cpu_lighter(task_man, best) ||
+            (task_man == prev && !cpu_lighter(best, task_man)))
+        {
+            best = task_man;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief 将不允许在src上运行的任务移动到允许运行的cpu
+ * @param src 任务当前所在的cpu
+ * @param task 任务(不在cpu上运行)
+ * @note 需关闭中断,不能持有task_list_lock.
+ *       就绪的任务迁移到目标cpu的就绪队列,阻塞的任务只修改cpu_id,
+ *       被唤醒时加入目标cpu的就绪队列.
+ *       状态为TASK_RUNNING但不在就绪队列中的任务是schedule()没有放回src的任务
+ */
+PRIVATE void push_task(task_man_t *src, task_struct_t *task)
+{
+    task_man_t *dst = select_task_cpu(task, NULL);
+    if (dst == NULL || dst == src)
+    {
+        return;
+    }
+    bool kick = FALSE;
+    double_lock(src, dst);
+    // 加锁前任务可能已被迁移或再次运行
+    if (task->cpu_id == src->cpu_id && !task->on_cpu)
+    {
+        if (task->on_rq)
+        {
+            migrate_task(task, src, dst);
+            kick = check_preempt_wakeup(dst, task);
+        }
+        else if (task->status == TASK_RUNNING)
+        {
+            task->cpu_id = dst->cpu_id;
+            if (task_is_fair(task))
+            {
+                rebase_entity(&task->se, task->se.cfs_rq,
+                              task_cfs_rq(dst, task));
+            }
+            task_list_insert(dst, task);
+            kick = check_preempt_wakeup(dst, task);
+        }
+        else
+        {
+            task->cpu_id = dst->cpu_id;
+        }
+    }
+    double_unlock(src, dst);
+
+    if (kick)
+    {
+        smp_send_reschedule(dst->cpu_id);
+    }
+    return;
+}
+
+/**
+ * @brief 被抢占的实时任务是否应回到同优先级队列的队首
+ * @param task 即将放回就绪队列的任务
+ * @note SCHED_RR的任务时间片用完时放到队尾,实现轮转
+ */
+PRIVATE bool rt_keep_head(task_struct_t *task)
+{
+    if (!task_is_rt(task))
+    {
+        return FALSE;
+    }
+    return task->policy == SCHED_FIFO || task->rt_slice_left > 0;
+}
+
+/**
+ * @brief 计算延迟所在的直方图桶
+ * @param ns 延迟(ns)
+ * @return 桶的下标,第i个桶统计[2^i, 2^(i+1))ns的样本
+ */
+PRIVATE uint32_t sched_hist_bucket(uint64_t ns)
+{
+    if (ns == 0)
+    {
+        return 0;
+    }
+    return MIN(63 - __builtin_clzll(ns), SCHED_HIST_BUCKETS - 1);
+}
+
+/**
+ * @brief 选出下一个任务后更新调度统计
+ * @param task_man 当前cpu的task_man
+ * @param prev 调用schedule()的任务
+ * @param prev_status prev调用schedule()时的状态
+ * @param next 将要运行的任务,可能与prev相同
+ * @param now 当前的TSC值
+ * @note 统计只由当前cpu更新,不需要加锁
+ */
+PRIVATE void sched_stat_switch(
+    task_man_t    *task_man,
+    task_struct_t *prev,
+    task_status_t  prev_status,
+    task_struct_t *next,
+    uint64_t       now
+)
+{
+    cpu_sched_stat_t *stat   = &task_man->sched_stat;
+    uint64_t          wakeup = next->wakeup_start;
+    next->wakeup_start       = 0;
+    if (next == prev)
+    {
+        return;
+    }
+    stat->nr_switches++;
+    if (prev_status != TASK_RUNNING)
+    {
+        prev->sched_stat.nr_voluntary++;
+        stat->nr_voluntary++;
+    }
+    else if (prev != task_man->idle_task)
+    {
+        prev->sched_stat.nr_involuntary++;
+        stat->nr_involuntary++;
+    }
+    if (next == task_man->idle_task)
+    {
+        return;
+    }
+
+    uint64_t wait = tsc_to_ns(now - next->wait_start);
+    next->sched_stat.nr_runs++;
+    next->sched_stat.rq_wait += wait;
+    next->sched_stat.rq_wait_max = MAX(next->sched_stat.rq_wait_max, wait);
+    stat->nr_runs++;
+    stat->rq_wait += wait;
+    stat->rq_wait_hist[sched_hist_bucket(wait)]++;
+
+    if (wakeup != 0)
+    {
+        uint64_t           latency   = tsc_to_ns(now - wakeup);
+        task_sched_stat_t *task_stat = &next->sched_stat;
+        task_stat->nr_wakeups++;
+        task_stat->wakeup_latency += latency;
+        task_stat->wakeup_latency_max =
+            MAX(task_stat->wakeup_latency_max, latency);
+        stat->nr_wakeups++;
+        stat->wakeup_latency += latency;
+        stat->wakeup_latency_hist[sched_hist_bucket(latency)]++;
+    }
+    return;
+}
+
+extern void ASMLINKAGE
+asm_switch_to(task_context_t **cur, task_context_t **next);
+
+/**
+ * @brief 从当前任务切换到next
+ * @param task_man 当前cpu的任务管理结构
+ * @param prev 当前任务
+ * @param prev_status 当前任务让出cpu时的状态
+ * @param next 下一个运行的任务(已离开就绪队列,可以与prev相同)
+ * @note 需关闭中断,不能持有task_list_lock
+ */
+PRIVATE void switch_to_next(
+    task_man_t    *task_man,
+    task_struct_t *prev,
+    task_status_t  prev_status,
+    task_struct_t *next
+)
+{
+    uint64_t now         = read_tsc();
+    next->status         = TASK_RUNNING;
+    next->cpu_id         = task_man->cpu_id;
+    next->slice_run_time = 0;
+    next->exec_start     = now;
+    stat_set_status(next, TASK_RUNNING, now);
+    sched_stat_switch(task_man, prev, prev_status, next, now);
+    if (next != prev)
+    {
+        next->on_cpu        = TRUE;
+        task_man->curr      = next;
+        task_man->prev_task = prev;
+        proc_activate(next);
+        if (prev == task_man->idle_task)
+        {
+            tick_nohz_idle_exit();
+        }
+        fpu_switch_out(task_man, prev);
+        asm_switch_to(&prev->context, &next->context);
+        schedule_tail();
+    }
+    return;
+}
+
+PUBLIC void schedule(void)
+{
+    task_struct_t *cur_task = running_task();
+    uint32_t       cpu_id   = cur_task->cpu_id;
+    task_man_t    *task_man = get_task_man(cpu_id);
+
+    if (cur_task->preempt_count > 0)
+    {
+        return;
+    }
+
+    intr_status_t intr_status = intr_disable();
+    task_man->need_resched    = FALSE;
+    task_account(cur_task, FALSE);
+
+    // 唤醒者会在持有task_list_lock时修改status
+    spinlock_lock(&task_man->task_list_lock);
+    task_status_t prev_status = cur_task->status;
+    stat_set_status(cur_task, prev_status, cur_task->exec_start);
+    put_prev_fair(task_man, cur_task);
+    spinlock_unlock(&task_man->task_list_lock);
+
+    switch (cur_task->status)
+    {
+        case TASK_RUNNING:
+            // idle只在就绪队列为空时运行,不放入就绪队列
+            if (cur_task == task_man->idle_task)
+            {
+                break;
+            }
+            // 不允许在此cpu上运行的任务在切换出去后由schedule_tail迁移
+            if (!CPUMASK_TEST(&cur_task->cpus_allowed, cpu_id))
+            {
+                break;
+            }
+            spinlock_lock(&task_man->task_list_lock);
+            task_list_enqueue(task_man, cur_task, rt_keep_head(cur_task));
+            spinlock_unlock(&task_man->task_list_lock);
+            break;
+
+        case TASK_DIED:
+            if (task_is_dl(cur_task))
+            {
+                // 释放deadline任务占用的带宽
+                spinlock_lock(&task_man->task_list_lock);
+                task_man->dl_bw -= cur_task->dl_bw;
+                spinlock_unlock(&task_man->task_list_lock);
+            }
+            inform_exit(cur_task->pid);
+            break;
+
+        default:
+            // 阻塞的任务由task_wakeup放回就绪队列,
+            // 唤醒时根据put_prev_fair记录的vlag放置
+            break;
+    }
+
+    uint64_t ticks = get_current_ticks();
+    if (task_list_empty(task_man))
+    {
+        load_balance(task_man, TRUE);
+    }
+    else if ((int64_t)(ticks - task_man->next_balance) >= 0)
+    {
+        task_man->next_balance = ticks + MS_TO_TICKS(LOAD_BALANCE_INTERVAL);
+        load_balance(task_man, FALSE);
+    }
+
+    task_struct_t *next = NULL;
+
+    spinlock_lock(&task_man->task_list_lock);
+    update_task_avg(task_man, cur_task);
+    update_cpu_avg(task_man);
+    next = get_next_task(task_man);
+    spinlock_unlock(&task_man->task_list_lock);
+
+    switch_to_next(task_man, cur_task, prev_status, next);
+    intr_set_status(intr_status);
+    return;
+}
+
+PUBLIC void ASMLINKAGE schedule_if_needed(void)
+{
+    task_man_t *task_man = get_task_man(running_task()->cpu_id);
+    if (task_man->need_resched)
+    {
+        schedule();
+    }
+    return;
+}
+
+PUBLIC void schedule_tail(void)
+{
+    task_man_t    *task_man = get_task_man(running_task()->cpu_id);
+    task_struct_t *prev     = task_man->prev_task;
+
+    // 上一个任务的上下文已经保存,此后可以被其他cpu迁移并运行
+    prev->on_cpu = FALSE;
+
+    // 上一个任务在运行期间被修改了cpus_allowed
+    if (prev->status != TASK_DIED &&
+        !CPUMASK_TEST(&prev->cpus_allowed, task_man->cpu_id))
+    {
+        push_task(task_man, prev);
+    }
+    return;
+}
+
+/**
+ * @brief 将任务添加到就绪队列中
+ * @param task_man 任务管理结构
+ * @param task 要添加的任务结构体指针
+ * @param head 实时任务是否加入同优先级队列的队首
+ * @note 需持有task_man->task_list_lock
+ */
+PRIVATE void
+task_list_enqueue(task_man_t *task_man, task_struct_t *task, bool head)
+{
+    ASSERT(task_man != NULL);
+    if (task->on_rq)
+    {
+        PR_LOG(LOG_WARN, "this task is already in the list: %s.\n", task->name);
+        return;
+    }
+    update_task_avg(task_man, task);
+    update_cpu_avg(task_man);
+    if (task_is_dl(task))
+    {
+        enqueue_task_dl(task_man, task);
+    }
+    else if (task_is_rt(task))
+    {
+        uint32_t prio = task->rt_priority;
+        if (task->policy == SCHED_RR && task->rt_slice_left == 0)
+        {
+            task->rt_slice_left = RT_RR_TIMESLICE;
+        }
+        if (head)
+        {
+            list_push(&task_man->rt_queue[prio], &task->rt_tag);
+        }
+        else
+        {
+            list_append(&task_man->rt_queue[prio], &task->rt_tag);
+        }
+        task_man->rt_bitmap |= 1U << prio;
+        task_man->rt_running++;
+    }
+    else
+    {
+        enqueue_task_fair(task_man, task);
+    }
+    task->on_rq      = TRUE;
+    task->wait_start = read_tsc();
+    task->status     = TASK_READY;
+    stat_set_status(task, TASK_READY, task->wait_start);
+    return;
+}
+
+PUBLIC void task_list_insert(task_man_t *task_man, task_struct_t *task)
+{
+    task_list_enqueue(task_man, task, FALSE);
+    return;
+}
+
+PUBLIC void task_block(task_status_t status)
+{
+    intr_status_t  intr_status = intr_disable();
+    task_struct_t *cur_task    = running_task();
+    ASSERT(cur_task->preempt_count == 0);
+    cur_task->status = status;
+    schedule();
+    intr_set_status(intr_status);
+    return;
+}
+
+PUBLIC void task_block_locked(task_status_t status, spinlock_t *lock)
+{
+    ASSERT(intr_get_status() == INTR_OFF);
+    task_struct_t *cur_task = running_task();
+    cur_task->status        = status;
+    spinlock_unlock(lock);
+    ASSERT(cur_task->preempt_count == 0);
+    schedule();
+    spinlock_lock(lock);
+    return;
+}
+
+// 超时等待使用的定时器
+typedef struct timeout_s
+{
+    timer_t        timer;
+    task_struct_t *task;
+    task_status_t  status;
+} timeout_t;
+
+PRIVATE void timeout_handler(timer_t *timer)
+{
+    timeout_t *timeout = CONTAINER_OF(timeout_t, timer, timer);
+    task_wakeup(timeout->task, timeout->status);
+    return;
+}
+
+/**
+ * @brief 阻塞当前任务,直到被唤醒或到达expires
+ * @param status 阻塞后的任务状态
+ * @param lock 保护等待条件的锁,可以为NULL
+ * @param expires 超时时刻(ticks)
+ * @return 超时返回TRUE
+ * @note 调用前需关闭中断.定时器加入当前cpu的队列,
+ *       在任务切换出去之前其回调函数不会执行,因此不会丢失唤醒
+ */
+PRIVATE bool
+block_until(task_status_t status, spinlock_t *lock, uint64_t expires)
+{
+    ASSERT(intr_get_status() == INTR_OFF);
+    task_struct_t *cur_task = running_task();
+
+    timeout_t timeout;
+    timeout.task   = cur_task;
+    timeout.status = status;
+    init_timer(&timeout.timer, timeout_handler);
+    timer_add(&timeout.timer, expires);
+
+    cur_task->status = status;
+    if (lock != NULL)
+    {
+        spinlock_unlock(lock);
+    }
+    ASSERT(cur_task->preempt_count == 0);
+    schedule();
+
+    // 定时器已不在队列中,说明已经到期
+    bool timed_out = !timer_del(&timeout.timer);
+    if (lock != NULL)
+    {
+        spinlock_lock(lock);
+    }
+    return timed_out;
+}
+
+PUBLIC status_t task_block_locked_timeout(
+    task_status_t status,
+    spinlock_t   *lock,
+    uint32_t      milliseconds
+)
+{
+    uint64_t expires = get_current_ticks() + MS_TO_TICKS(milliseconds);
+    if (block_until(status, lock, expires))
+    {
+        return K_TIMEOUT;
+    }
+    return K_SUCCESS;
+}
+
+/**
+ * @brief 判断被唤醒的普通任务是否应当抢占正在运行的普通任务
+ * @param task 被唤醒的任务(已加入就绪队列)
+ * @param curr 正在运行的任务
+ * @note 在两者位于同一队列的祖先实体之间比较,
+ *       不同任务组的任务之间比较的是任务组的实体
+ */
+PRIVATE bool check_preempt_fair(task_struct_t *task, task_struct_t *curr)
+{
+    sched_entity_t *curr_se = &curr->se;
+    while (curr_se->cfs_rq != NULL && curr_se->cfs_rq->curr == curr_se)
+    {
+        cfs_rq_t       *cfs = curr_se->cfs_rq;
+        sched_entity_t *se  = &task->se;
+        while (se != NULL && se->cfs_rq != cfs)
+        {
+            se = parent_entity(se);
+        }
+        if (se != NULL)
+        {
+            if (!sched_eevdf)
+            {
+                return (int64_t)(curr_se->vrun_time - se->vrun_time) >
+                       WAKEUP_GRANULARITY;
+            }
+            // 被唤醒的实体合格且截止时间更早时,下一次调度会选中它
+            return vrun_eligible(cfs, se->vrun_time) &&
+                   (int64_t)(se->deadline - curr_se->deadline) < 0;
+        }
+        if (cfs->se == NULL)
+        {
+            break;
+        }
+        curr_se = cfs->se;
+    }
+    return FALSE;
+}
+
+/**
+ * @brief 在任务被唤醒加入就绪队列前,根据vlag放置任务
+ * @param task_man 任务将加入的就绪队列所属的任务管理结构
+ * @param task 被唤醒的任务
+ * @note 需持有task_man->task_list_lock.
+ *       deadline任务按CBS的规则更新预算与截止时间
+ */
+PRIVATE void place_task(task_man_t *task_man, task_struct_t *task)
+{
+    if (task_is_dl(task))
+    {
+        dl_wakeup(task);
+        return;
+    }
+    if (task_is_rt(task))
+    {
+        return;
+    }
+    cfs_rq_t *cfs = task_cfs_rq(task_man, task);
+    if (!sched_eevdf)
+    {
+        task->se.cfs_rq = cfs;
+        return;
+    }
+    place_entity(cfs, &task->se);
+    return;
+}
+
+/**
+ * @brief 被唤醒的任务应当抢占当前任务时,设置need_resched
+ * @param task_man 任务被放入的就绪队列所属的任务管理结构
+ * @param task 被唤醒的任务
+ * @return 需要向task_man所属的cpu发送调度IPI时返回TRUE
+ * @note 需持有task_man->task_list_lock.
+ *       目标cpu可能正在运行用户态任务或处于hlt状态(且停止了周期性时钟),
+ *       设置need_resched后需要IPI才能使其及时调度
+ */
+PRIVATE bool check_preempt_wakeup(task_man_t *task_man, task_struct_t *task)
+{
+    task_struct_t *curr = task_man->curr;
+    bool           preempt;
+    if (curr == task_man->idle_task)
+    {
+        // 被限制的deadline任务也需要唤醒idle,以恢复周期性时钟
+        preempt = TRUE;
+    }
+    else if (task_is_dl(task))
+    {
+        // 被限制的任务在补充预算时再检查
+        preempt = !task->dl_throttled && dl_preempt(task, curr);
+    }
+    else if (task_is_dl(curr))
+    {
+        preempt = FALSE;
+    }
+    else if (task_is_rt(task))
+    {
+        // 实时任务抢占普通任务与优先级更低的实时任务
+        preempt = !task_man->rt_throttled &&
+                  (!task_is_rt(curr) || task->rt_priority > curr->rt_priority);
+    }
+    else if (task_is_rt(curr))
+    {
+        preempt = FALSE;
+    }
+    else
+    {
+        preempt = check_preempt_fair(task, curr);
+    }
+    if (!preempt)
+    {
+        return FALSE;
+    }
+    task_man->need_resched = TRUE;
+    return task_man->cpu_id != running_task()->cpu_id;
+}
+
+/**
+ * @brief 判断任务是否可以改变所在的cpu(放置到其他cpu的就绪队列)
+ * @note 只有已完全切换出去且不在就绪队列中的新建或阻塞的任务可以改变cpu.
+ *       deadline任务的带宽计入所在的cpu,不能改变cpu
+ */
+PRIVATE bool task_can_place(task_struct_t *task)
+{
+    return !task_is_dl(task) && !task->on_cpu && !task->on_rq &&
+           task->status != TASK_RUNNING && task->status != TASK_DIED;
+}
+
+/**
+ * @brief 为即将放入就绪队列的任务选择cpu,并获取该cpu的task_list_lock
+ * @param task 新建或被唤醒的任务
+ * @return 已加锁的任务管理结构,task->cpu_id与之相同
+ * @note 需关闭中断.任务不能改变cpu时仍使用原来的cpu,
+ *       调用者需在加锁后重新检查任务的状态
+ */
+PRIVATE task_man_t *task_place_lock(task_struct_t *task)
+{
+    while (1)
+    {
+        task_man_t *src = get_task_man(task->cpu_id);
+        task_man_t *dst = NULL;
+        if (task_can_place(task))
+        {
+            dst = select_task_cpu(task, src);
+        }
+        if (dst == NULL || dst == src)
+        {
+            spinlock_lock(&src->task_list_lock);
+            // 任务可能在读取cpu_id后被唤醒、迁移并再次阻塞,需重新确认
+            if (task->cpu_id == src->cpu_id)
+            {
+                return src;
+            }
+            spinlock_unlock(&src->task_list_lock);
+            continue;
+        }
+        double_lock(src, dst);
+        if (task->cpu_id == src->cpu_id && task_can_place(task))
+        {
+            task->cpu_id = dst->cpu_id;
+            spinlock_unlock(&src->task_list_lock);
+            return dst;
+        }
+        double_unlock(src, dst);
+    }
+}
+
+/**
+ * @brief 判断当前任务阻塞时能否不经过就绪队列直接切换到被唤醒的任务
+ * @param task_man 当前cpu的任务管理结构
+ * @param cur 当前任务
+ * @param status 当前任务阻塞后的状态
+ * @param next 被唤醒的任务
+ * @param next_status next应处于的阻塞状态
+ * @note 需持有task_man与next所在cpu的task_list_lock.
+ *       只在两者都是根任务组中的普通任务,且此cpu上没有实时与deadline任务时
+ *       直接切换,其他情况交给调度器按正常流程选择
+ */
+PRIVATE bool can_handoff(
+    task_man_t    *task_man,
+    task_struct_t *cur,
+    task_status_t  status,
+    task_struct_t *next,
+    task_status_t  next_status
+)
+{
+    // 当前任务可能已被唤醒
+    if (cur->status != status || cur->on_rq)
+    {
+        return FALSE;
+    }
+    if (next->status != next_status || next->on_rq || next->on_cpu)
+    {
+        return FALSE;
+    }
+    if (!task_is_fair(cur) || !task_is_fair(next) ||
+        task_man->dl_running != 0 || task_man->rt_running != 0)
+    {
+        return FALSE;
+    }
+    if (!CPUMASK_TEST(&next->cpus_allowed, task_man->cpu_id))
+    {
+        return FALSE;
+    }
+    if (next->cpu_id != task_man->cpu_id && !task_can_place(next))
+    {
+        return FALSE;
+    }
+    return cur->se.cfs_rq == &task_man->cfs &&
+           task_cfs_rq(task_man, next) == &task_man->cfs;
+}
+
+PUBLIC void task_block_handoff(
+    task_status_t  status,
+    spinlock_t    *lock,
+    task_struct_t *next,
+    task_status_t  next_status
+)
+{
+    ASSERT(intr_get_status() == INTR_OFF);
+    task_struct_t *cur_task = running_task();
+    task_man_t    *task_man = get_task_man(cur_task->cpu_id);
+    ASSERT(cur_task->preempt_count == 0);
+    cur_task->status = status;
+    spinlock_unlock(lock);
+    task_account(cur_task, FALSE);
+
+    task_man_t *src = NULL;
+    while (1)
+    {
+        src = get_task_man(next->cpu_id);
+        if (src == task_man)
+        {
+            spinlock_lock(&task_man->task_list_lock);
+        }
+        else
+        {
+            double_lock(task_man, src);
+        }
+        // 任务可能在读取cpu_id后被迁移,需重新确认
+        if (next->cpu_id == src->cpu_id)
+        {
+            break;
+        }
+        if (src == task_man)
+        {
+            spinlock_unlock(&task_man->task_list_lock);
+        }
+        else
+        {
+            double_unlock(task_man, src);
+        }
+    }
+
+    if (!can_handoff(task_man, cur_task, status, next, next_status))
+    {
+        if (src == task_man)
+        {
+            spinlock_unlock(&task_man->task_list_lock);
+        }
+        else
+        {
+            double_unlock(task_man, src);
+        }
+        task_wakeup(next, next_status);
+        schedule();
+        spinlock_lock(lock);
+        return;
+    }
+
+    // next不进入就绪队列,直接成为此cpu上正在运行的任务
+    stat_set_status(cur_task, status, cur_task->exec_start);
+    put_prev_fair(task_man, cur_task);
+    update_task_avg(task_man, cur_task);
+    if (src != task_man)
+    {
+        next->cpu_id = task_man->cpu_id;
+        spinlock_unlock(&src->task_list_lock);
+    }
+    update_task_avg(task_man, next);
+    update_cpu_avg(task_man);
+    place_task(task_man, next);
+    task_man->cfs.curr = &next->se;
+    next->wait_start   = read_tsc();
+    next->wakeup_start = next->wait_start;
+    // 释放锁前标记next正在运行,否则在切换之前其他cpu会将其视为阻塞的任务,
+    // task_wakeup可能将其放入就绪队列,task_set_*可能在其运行前修改其调度类
+    next->status   = TASK_RUNNING;
+    next->on_cpu   = TRUE;
+    task_man->curr = next;
+    spinlock_unlock(&task_man->task_list_lock);
+
+    switch_to_next(task_man, cur_task, status, next);
+    spinlock_lock(lock);
+    return;
+}
+
+PUBLIC bool task_wakeup(task_struct_t *task, task_status_t status)
+{
+    intr_status_t intr_status = intr_disable();
+
+    bool        woken    = FALSE;
+    task_man_t *task_man = task_place_lock(task);
+    bool        kick     = FALSE;
+    if (task->status == status && !task->on_rq)
+    {
+        place_task(task_man, task);
+        task_list_insert(task_man, task);
+        task->wakeup_start = task->wait_start;
+        woken              = TRUE;
+        kick  = check_preempt_wakeup(task_man, task);
+    }
+    spinlock_unlock(&task_man->task_list_lock);
+
+    if (kick)
+    {
+        smp_send_reschedule(task_man->cpu_id);
+    }
+
+    intr_set_status(intr_status);
+    return woken;
+}
+
+PUBLIC void task_unblock(pid_t pid)
+{
+    intr_status_t intr_status = intr_disable();
+
+    task_struct_t *task     = pid_to_task(pid);
+    task_man_t    *task_man = task_place_lock(task);
+
+    bool kick = task_unblock_sub(pid);
+    spinlock_unlock(&task_man->task_list_lock);
+
+    if (kick)
+    {
+        smp_send_reschedule(task_man->cpu_id);
+    }
+
+    intr_set_status(intr_status);
+    return;
+}
+
+PUBLIC bool task_unblock_sub(pid_t pid)
+{
+    task_struct_t *task     = pid_to_task(pid);
+    task_man_t    *task_man = get_task_man(task->cpu_id);
+    ASSERT(task != NULL);
+    place_task(task_man, task);
+    task_list_insert(task_man, task);
+    task->wakeup_start = task->wait_start; // 唤醒延迟从加入就绪队列时开始计算
+    return check_preempt_wakeup(task_man, task);
+}
+
+PUBLIC status_t
+task_set_scheduler(task_struct_t *task, uint32_t policy, uint32_t rt_priority)
+{
+    if (policy != SCHED_NORMAL && policy != SCHED_FIFO && policy != SCHED_RR)
+    {
+        return K_INVALID_PARAM;
+    }
+    if (policy != SCHED_NORMAL && rt_priority >= RT_PRIORITIES)
+    {
+        return K_INVALID_PARAM;
+    }
+
+    intr_status_t intr_status = intr_disable();
+
+    task_man_t *task_man;
+    while (1)
+    {
+        task_man = get_task_man(task->cpu_id);
+        spinlock_lock(&task_man->task_list_lock);
+        if (task->cpu_id == task_man->cpu_id)
+        {
+            break;
+        }
+        spinlock_unlock(&task_man->task_list_lock);
+    }
+    // 先从就绪队列中取出,修改策略后再放回对应的队列
+    bool queued = task->on_rq;
+    if (queued)
+    {
+        task_list_remove(task_man, task);
+    }
+    bool to_fair = !task_is_fair(task) && policy == SCHED_NORMAL;
+    if (task_is_dl(task))
+    {
+        // 离开SCHED_DEADLINE,释放占用的带宽
+        task_man->dl_bw -= task->dl_bw;
+        task->dl_bw = 0;
+    }
+    task->policy        = policy;
+    task->rt_priority   = policy == SCHED_NORMAL ? 0 : rt_priority;
+    task->rt_slice_left = policy == SCHED_RR ? RT_RR_TIMESLICE : 0;
+    if (to_fair)
+    {
+        // 以平均vrun_time回到普通任务中
+        task->se.vlag = 0;
+        place_entity(task_cfs_rq(task_man, task), &task->se);
+    }
+
+    bool kick = FALSE;
+    if (queued)
+    {
+        task_list_insert(task_man, task);
+        kick = check_preempt_wakeup(task_man, task);
+    }
+    else if (task_man->curr == task)
+    {
+        // 正在运行的任务降低了优先级,可能需要让出cpu
+        task_man->need_resched = TRUE;
+        kick = task_man->cpu_id != running_task()->cpu_id;
+    }
+    spinlock_unlock(&task_man->task_list_lock);
+
+    if (kick)
+    {
+        smp_send_reschedule(task_man->cpu_id);
+    }
+
+    intr_set_status(intr_status);
+    return K_SUCCESS;
+}
+
+PUBLIC status_t task_set_deadline(
+    task_struct_t *task,
+    uint64_t       runtime,
+    uint64_t       deadline,
+    uint64_t       period
+)
+{
+    if (deadline == 0)
+    {
+        deadline = period;
+    }
+    if (runtime < DL_MIN_RUNTIME || runtime > deadline || deadline > period ||
+        period > DL_MAX_PERIOD)
+    {
+        return K_INVALID_PARAM;
+    }
+    uint64_t bw = (runtime << DL_BW_SHIFT) / deadline;
+
+    intr_status_t intr_status = intr_disable();
+
+    task_man_t *task_man;
+    while (1)
+    {
+        task_man = get_task_man(task->cpu_id);
+        spinlock_lock(&task_man->task_list_lock);
+        if (task->cpu_id == task_man->cpu_id)
+        {
+            break;
+        }
+        spinlock_unlock(&task_man->task_list_lock);
+    }
+    // 准入控制: 任务所在cpu上deadline任务的总带宽不能超过上限.
+    // 正在运行的任务修改cpus_allowed后尚未迁移时,不能固定在此cpu上
+    uint64_t old_bw = task_is_dl(task) ? task->dl_bw : 0;
+    if (!CPUMASK_TEST(&task->cpus_allowed, task_man->cpu_id) ||
+        task_man->dl_bw - old_bw + bw > DL_BW_LIMIT)
+    {
+        spinlock_unlock(&task_man->task_list_lock);
+        intr_set_status(intr_status);
+        return K_OUT_OF_RESOURCE;
+    }
+    bool queued = task->on_rq;
+    if (queued)
+    {
+        task_list_remove(task_man, task);
+    }
+    task_man->dl_bw = task_man->dl_bw - old_bw + bw;
+
+    task->policy        = SCHED_DEADLINE;
+    task->rt_priority   = 0;
+    task->rt_slice_left = 0;
+    task->dl_runtime    = runtime;
+    task->dl_deadline   = deadline;
+    task->dl_period     = period;
+    task->dl_bw         = bw;
+
+    // 从当前时刻开始第一个周期
+    task->dl_abs_deadline = tsc_to_ns(read_tsc()) + deadline;
+    task->dl_budget       = (int64_t)runtime;
+
+    bool kick = FALSE;
+    if (queued)
+    {
+        task_list_insert(task_man, task);
+        kick = check_preempt_wakeup(task_man, task);
+    }
+    else if (task_man->curr == task)
+    {
+        // 正在运行的任务改变了调度类,重新选择任务
+        task_man->need_resched = TRUE;
+        kick = task_man->cpu_id != running_task()->cpu_id;
+    }
+    spinlock_unlock(&task_man->task_list_lock);
+
+    if (kick)
+    {
+        smp_send_reschedule(task_man->cpu_id);
+    }
+
+    intr_set_status(intr_status);
+    return K_SUCCESS;
+}
+
+PUBLIC status_t task_set_affinity(task_struct_t *task, const cpumask_t *mask)
+{
+    intr_status_t intr_status = intr_disable();
+
+    task_man_t *task_man;
+    while (1)
+    {
+        task_man = get_task_man(task->cpu_id);
+        spinlock_lock(&task_man->task_list_lock);
+        if (task->cpu_id == task_man->cpu_id)
+        {
+            break;
+        }
+        spinlock_unlock(&task_man->task_list_lock);
+    }
+    // deadline任务不能离开所在的cpu
+    if (task_is_dl(task) && !CPUMASK_TEST(mask, task_man->cpu_id))
+    {
+        spinlock_unlock(&task_man->task_list_lock);
+        intr_set_status(intr_status);
+        return K_INVALID_PARAM;
+    }
+    cpumask_t old      = task->cpus_allowed;
+    task->cpus_allowed = *mask;
+    if (select_task_cpu(task, NULL) == NULL)
+    {
+        task->cpus_allowed = old;
+        spinlock_unlock(&task_man->task_list_lock);
+        intr_set_status(intr_status);
+        return K_INVALID_PARAM;
+    }
+    bool allowed = CPUMASK_TEST(mask, task_man->cpu_id);
+    bool running = task->on_cpu;
+    bool kick    = FALSE;
+    if (!allowed && running)
+    {
+        // 正在运行的任务需要先切换出去,再由schedule_tail迁移
+        task_man->need_resched = TRUE;
+        kick = task_man->cpu_id != running_task()->cpu_id;
+    }
+    spinlock_unlock(&task_man->task_list_lock);
+
+    if (kick)
+    {
+        smp_send_reschedule(task_man->cpu_id);
+    }
+    if (!allowed && !running)
+    {
+        push_task(task_man, task);
+    }
+
+    intr_set_status(intr_status);
+    return K_SUCCESS;
+}
+
+PUBLIC uint32_t task_get_sched_avg(
+    task_struct_t *task,
+    sched_avg_t   *task_avg,
+    sched_avg_t   *cpu_avg
+)
+{
+    intr_status_t intr_status = intr_disable();
+    task_man_t   *task_man;
+    while (1)
+    {
+        task_man = get_task_man(task->cpu_id);
+        spinlock_lock(&task_man->task_list_lock);
+        if (task->cpu_id == task_man->cpu_id)
+        {
+            break;
+        }
+        spinlock_unlock(&task_man->task_list_lock);
+    }
+    update_task_avg(task_man, task);
+    update_cpu_avg(task_man);
+    *task_avg = task->avg;
+    *cpu_avg  = task_man->avg;
+    spinlock_unlock(&task_man->task_list_lock);
+
+    intr_set_status(intr_status);
+    return task_man->cpu_id;
+}
+
+PUBLIC status_t task_set_slice(task_struct_t *task, uint64_t slice)
+{
+    if (slice == 0)
+    {
+        slice = SCHED_BASE_SLICE;
+    }
+    if (slice < SCHED_MIN_SLICE || slice > SCHED_MAX_SLICE)
+    {
+        return K_INVALID_PARAM;
+    }
+    // 新的时间片在当前截止时间到达后生效
+    task->se.slice = slice;
+    return K_SUCCESS;
+}
+
+struct task_group_s
+{
+    uint32_t        id;               // 任务组的id
+    bool            used;             // 为FALSE时任务组已释放,可被重用
+    pid_t           owner;            // 属主(创建者),PID_NO_TASK表示已退出
+    uint64_t        nr_tasks;         // 属于任务组且未退出的任务数量
+    uint64_t        weight;           // 任务组在每个cpu上的实体的权重
+    cfs_rq_t       *cfs_rq[NR_CPUS];  // 任务组在各cpu上的队列
+    sched_entity_t *se[NR_CPUS];      // 任务组在各cpu上的实体
+};
+
+// 任务组在一个cpu上的队列与代表它的实体
+typedef struct group_rq_s
+{
+    cfs_rq_t       cfs;
+    sched_entity_t se;
+} group_rq_t;
+
+PRIVATE cfs_rq_t *task_cfs_rq(task_man_t *task_man, task_struct_t *task)
+{
+    if (task->group == NULL)
+    {
+        return &task_man->cfs;
+    }
+    return task->group->cfs_rq[task_man->cpu_id];
+}
+
+/**
+ * @brief 根据id获取任务组
+ * @return 任务组,id为0或任务组不存在时返回NULL
+ * @note 需持有groups_lock.任务组的结构体不会被释放,释放后由新的任务组重用
+ */
+PRIVATE task_group_t *get_task_group(uint32_t id)
+{
+    if (id >= TASK_GROUPS)
+    {
+        return NULL;
+    }
+    task_group_t *group = get_global_task_man()->groups[id];
+    if (group == NULL || !group->used)
+    {
+        return NULL;
+    }
+    return group;
+}
+
+/**
+ * @brief 属主已退出且没有任务时释放任务组
+ * @note 需持有groups_lock
+ */
+PRIVATE void task_group_try_release(task_group_t *group)
+{
+    if (group->owner == PID_NO_TASK && group->nr_tasks == 0)
+    {
+        group->used = FALSE;
+    }
+    return;
+}
+
+/**
+ * @brief 修改任务组在各cpu上的实体的权重
+ */
+PRIVATE void task_group_reweight(task_group_t *group, uint64_t weight)
+{
+    intr_status_t intr_status = intr_disable();
+    group->weight             = weight;
+    int i;
+    for (i = 0; i < apic.number_of_cores; i++)
+    {
+        task_man_t *task_man = get_task_man(apic.lapic_id[i]);
+        spinlock_lock(&task_man->task_list_lock);
+        reweight_entity(group->se[task_man->cpu_id], weight);
+        spinlock_unlock(&task_man->task_list_lock);
+    }
+    intr_set_status(intr_status);
+    return;
+}
+
+PUBLIC status_t task_group_create(uint64_t weight, pid_t owner, uint32_t *id)
+{
+    if (weight < TASK_GROUP_MIN_WEIGHT || weight > TASK_GROUP_MAX_WEIGHT)
+    {
+        return K_INVALID_PARAM;
+    }
+
+    // 优先重用已释放的任务组,其队列中可能还有正在退出的任务,不重新初始化
+    global_task_man_t *global_task_man = get_global_task_man();
+    task_group_t      *group           = NULL;
+    uint64_t           owned           = 0;
+    int                i;
+    spinlock_lock(&global_task_man->groups_lock);
+    for (i = 1; i < TASK_GROUPS; i++)
+    {
+        task_group_t *g = global_task_man->groups[i];
+        if (g == NULL)
+        {
+            continue;
+        }
+        if (g->used && g->owner == owner)
+        {
+            owned++;
+        }
+        if (!g->used && group == NULL)
+        {
+            group = g;
+        }
+    }
+    if (owned >= TASK_GROUPS_PER_OWNER)
+    {
+        spinlock_unlock(&global_task_man->groups_lock);
+        return K_ERROR;
+    }
+    if (group != NULL)
+    {
+        group->used     = TRUE;
+        group->owner    = owner;
+        group->nr_tasks = 0;
+        spinlock_unlock(&global_task_man->groups_lock);
+        task_group_reweight(group, weight);
+        *id = group->id;
+        return K_SUCCESS;
+    }
+    spinlock_unlock(&global_task_man->groups_lock);
+
+    group_rq_t *rqs;
+    if (ERROR(kmalloc(sizeof(*group), 0, 0, &group)))
+    {
+        return K_ERROR;
+    }
+    if (ERROR(kmalloc(sizeof(*rqs) * apic.number_of_cores, 0, 0, &rqs)))
+    {
+        kfree(group);
+        return K_ERROR;
+    }
+    memset(group, 0, sizeof(*group));
+    memset(rqs, 0, sizeof(*rqs) * apic.number_of_cores);
+    group->used   = TRUE;
+    group->owner  = owner;
+    group->weight = weight;
+
+    for (i = 0; i < apic.number_of_cores; i++)
+    {
+        uint32_t        cpu_id = apic.lapic_id[i];
+        cfs_rq_t       *cfs    = &rqs[i].cfs;
+        sched_entity_t *se     = &rqs[i].se;
+        init_cfs_rq(cfs, se);
+        se->weight            = weight;
+        se->slice             = SCHED_BASE_SLICE;
+        se->cfs_rq            = &get_task_man(cpu_id)->cfs;
+        se->my_q              = cfs;
+        group->cfs_rq[cpu_id] = cfs;
+        group->se[cpu_id]     = se;
+    }
+
+    spinlock_lock(&global_task_man->groups_lock);
+    for (i = 1; i < TASK_GROUPS; i++)
+    {
+        if (global_task_man->groups[i] == NULL)
+        {
+            group->id                  = i;
+            global_task_man->groups[i] = group;
+            break;
+        }
+    }
+    spinlock_unlock(&global_task_man->groups_lock);
+
+    if (i == TASK_GROUPS)
+    {
+        kfree(rqs);
+        kfree(group);
+        return K_ERROR;
+    }
+    *id = i;
+    return K_SUCCESS;
+}
+
+PUBLIC status_t
+task_group_set_weight(uint32_t id, uint64_t weight, pid_t caller)
+{
+    if (weight < TASK_GROUP_MIN_WEIGHT || weight > TASK_GROUP_MAX_WEIGHT)
+    {
+        return K_INVALID_PARAM;
+    }
+    global_task_man_t *global_task_man = get_global_task_man();
+    spinlock_lock(&global_task_man->groups_lock);
+    task_group_t *group = get_task_group(id);
+    bool          allow = group != NULL &&
+                 (caller == PID_NO_TASK || group->owner == caller);
+    spinlock_unlock(&global_task_man->groups_lock);
+    if (!allow)
+    {
+        return K_INVALID_PARAM;
+    }
+    // 此后任务组被释放也只是修改一个空闲任务组的权重,重用时会重新设置
+    task_group_reweight(group, weight);
+    return K_SUCCESS;
+}
+
+PUBLIC status_t task_set_group(task_struct_t *task, uint32_t id, pid_t caller)
+{
+    global_task_man_t *global_task_man = get_global_task_man();
+    intr_status_t      intr_status     = intr_disable();
+    spinlock_lock(&global_task_man->groups_lock);
+
+    task_group_t *group = get_task_group(id);
+    task_group_t *old   = task->group;
+
+    // 已退出的任务在回收时离开任务组.
+    // 只有属主能将任务移入或移出任务组,因此任务不能离开继承的任务组
+    bool allow = (id == 0 || group != NULL) && task->status != TASK_DIED;
+    if (caller != PID_NO_TASK)
+    {
+        allow = allow && (group == NULL || group->owner == caller) &&
+                (old == NULL || old->owner == caller);
+    }
+    if (!allow)
+    {
+        spinlock_unlock(&global_task_man->groups_lock);
+        intr_set_status(intr_status);
+        return K_INVALID_PARAM;
+    }
+    if (group != NULL)
+    {
+        group->nr_tasks++;
+    }
+    if (old != NULL)
+    {
+        old->nr_tasks--;
+        task_group_try_release(old);
+    }
+
+    task_man_t *task_man;
+    while (1)
+    {
+        task_man = get_task_man(task->cpu_id);
+        spinlock_lock(&task_man->task_list_lock);
+        if (task->cpu_id == task_man->cpu_id)
+        {
+            break;
+        }
+        spinlock_unlock(&task_man->task_list_lock);
+    }
+    // 就绪的任务取出后放入新任务组的队列,阻塞的任务在被唤醒时放入
+    bool queued = task->on_rq && task_is_fair(task);
+    if (queued)
+    {
+        task_list_remove(task_man, task);
+    }
+    task->group = group;
+
+    bool kick = FALSE;
+    if (queued)
+    {
+        task_list_insert(task_man, task);
+        kick = check_preempt_wakeup(task_man, task);
+    }
+    else if (task_man->curr == task && task_is_fair(task))
+    {
+        // 正在运行的任务切换出去后才离开原来的任务组
+        task_man->need_resched = TRUE;
+        kick = task_man->cpu_id != running_task()->cpu_id;
+    }
+    spinlock_unlock(&task_man->task_list_lock);
+    spinlock_unlock(&global_task_man->groups_lock);
+
+    if (kick)
+    {
+        smp_send_reschedule(task_man->cpu_id);
+    }
+
+    intr_set_status(intr_status);
+    return K_SUCCESS;
+}
+
+PUBLIC uint32_t task_get_group(task_struct_t *task)
+{
+    task_group_t *group = task->group;
+    return group == NULL ? 0 : group->id;
+}
+
+PUBLIC void task_group_inherit(task_struct_t *child, task_struct_t *parent)
+{
+    global_task_man_t *global_task_man = get_global_task_man();
+    spinlock_lock(&global_task_man->groups_lock);
+    child->group = parent->group;
+    if (child->group != NULL)
+    {
+        child->group->nr_tasks++;
+    }
+    spinlock_unlock(&global_task_man->groups_lock);
+    return;
+}
+
+PUBLIC void task_group_exit(task_struct_t *task)
+{
+    global_task_man_t *global_task_man = get_global_task_man();
+    spinlock_lock(&global_task_man->groups_lock);
+    // 属主退出后任务组只能由内核管理,组内的任务全部退出后释放
+    int i;
+    for (i = 1; i < TASK_GROUPS; i++)
+    {
+        task_group_t *group = global_task_man->groups[i];
+        if (group != NULL && group->used && group->owner == task->pid)
+        {
+            group->owner = PID_NO_TASK;
+            task_group_try_release(group);
+        }
+    }
+    task_group_t *group = task->group;
+    if (group != NULL)
+    {
+        group->nr_tasks--;
+        task_group_try_release(group);
+    }
+    task->group = NULL;
+    spinlock_unlock(&global_task_man->groups_lock);
+    return;
+}
+
+PUBLIC void task_yield(void)
+{
+    intr_status_t  intr_status = intr_disable();
+    task_struct_t *cur_task    = running_task();
+    if (task_is_dl(cur_task))
+    {
+        // 放弃本周期剩余的预算,schedule()将任务放入限制队列
+        cur_task->dl_budget = 0;
+    }
+    schedule();
+    intr_set_status(intr_status);
+    return;
+}
+
+PUBLIC void task_msleep(uint32_t milliseconds)
+{
+    uint64_t      expires     = get_current_ticks() + MS_TO_TICKS(milliseconds);
+    intr_status_t intr_status = intr_disable();
+
+    while ((int64_t)(get_current_ticks() - expires) < 0)
+    {
+        block_until(TASK_SLEEPING, NULL, expires);
+    }
+
+    intr_set_status(intr_status);
+    return;
+}
@@ -8,11 +8,13 @@
 #include <log.h>
 
 #include <device/cpu.h>     // apic_id
+#include <device/timer.h>   // tick_nohz_idle_enter,tick_nohz_idle_exit
 #include <intr.h>           // intr functions
-#include <io.h>             // get_cr3 get_rsp
+#include <io.h>             // get_cr3 get_rsp io_stihlt read_tsc
 #include <kernel/syscall.h> // sys_send_recv
 #include <mem/allocator.h> // kmalloc,to_physical_address,init_alloc_physical_page
 #include <mem/page.h>      // VIRT_TO_PHYS,PHYS_TO_VIRT
+#include <mem/shm.h>       // shm_task_exit
 #include <service.h>       // MM_EXIT
 #include <std/string.h>    // memset,strlen,strcpy
 #include <sync/atomic.h>   // atomic functions
@@ -22,6 +24,7 @@ PRIVATE global_task_man_t *global_task_man;
 
 PRIVATE void kernel_task(uintptr_t func, uint64_t arg)
 {
+    schedule_tail();
     intr_enable();
     sse_init();
     ((void (*)(uint64_t))func)(arg);
@@ -41,37 +44,82 @@ PUBLIC task_man_t *get_task_man(uint32_t cpu_id)
     return &global_task_man->cpus[cpu_id];
 }
 
+/**
+ * @brief 获取pid在pid_map中对应的项
+ * @param pid pid
+ * @param alloc 二级表不存在时是否分配
+ * @return pid_map中的项,二级表不存在(且未分配)时返回NULL
+ */
+PRIVATE task_struct_t **pid_map_entry(pid_t pid, bool alloc)
+{
+    task_struct_t ***dir;
+    dir = &global_task_man->pid_map[pid / PID_MAP_LEAF_ENTRIES];
+    if (*dir == NULL)
+    {
+        if (!alloc)
+        {
+            return NULL;
+        }
+        task_struct_t **leaf;
+        size_t          size = PID_MAP_LEAF_ENTRIES * sizeof(*leaf);
+        if (ERROR(kmalloc(size, 0, 0, &leaf)))
+        {
+            return NULL;
+        }
+        memset(leaf, 0, size);
+        *dir = leaf;
+    }
+    return &(*dir)[pid % PID_MAP_LEAF_ENTRIES];
+}
+
 PUBLIC task_struct_t *pid_to_task(pid_t pid)
 {
-    if (pid > MAX_PID || !task_exist(pid))
+    if (pid < MIN_PID || pid > MAX_PID)
     {
         return NULL;
     }
-    return &global_task_man->tasks[pid];
+    task_struct_t **leaf;
+    leaf = global_task_man->pid_map[pid / PID_MAP_LEAF_ENTRIES];
+    if (leaf == NULL)
+    {
+        return NULL;
+    }
+    return leaf[pid % PID_MAP_LEAF_ENTRIES];
 }
 
-PRIVATE pid_t task_to_pid(task_struct_t *task)
+PUBLIC task_struct_t *task_get(pid_t pid)
 {
-    pid_t ret;
-
-    ret = ((uintptr_t)task - (uintptr_t)&global_task_man->tasks);
-    ret = ret / sizeof(*task);
-
-    if (ret > MAX_PID)
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&global_task_man->tasks_lock);
+    task_struct_t *task = pid_to_task(pid);
+    if (task != NULL)
     {
-        return PID_NO_TASK;
+        task->refs++;
     }
-
-    return ret;
+    spinlock_unlock(&global_task_man->tasks_lock);
+    intr_set_status(intr_status);
+    return task;
 }
 
-PUBLIC bool task_exist(pid_t pid)
+PUBLIC void task_put(task_struct_t *task)
 {
-    if (pid >= 0 && pid <= MAX_PID)
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&global_task_man->tasks_lock);
+    ASSERT(task->refs > 0);
+    task->refs--;
+    if (task->refs == 0)
     {
-        return get_global_task_man()->tasks[pid].pid != PID_NO_TASK;
+        // 已回收的任务不在任何列表中,general_tag可以用于空闲列表
+        list_append(&global_task_man->free_tasks, &task->general_tag);
     }
-    return 0;
+    spinlock_unlock(&global_task_man->tasks_lock);
+    intr_set_status(intr_status);
+    return;
+}
+
+PUBLIC bool task_exist(pid_t pid)
+{
+    return pid_to_task(pid) != NULL;
 }
 
 // running_task() can only be called in ring 0
@@ -80,22 +128,96 @@ PUBLIC task_struct_t *running_task(void)
     return (task_struct_t *)rdmsr(IA32_KERNEL_GS_BASE);
 }
 
+/**
+ * @brief 从next_pid开始查找未使用的pid并标记为已使用
+ * @return 成功返回pid,没有可用的pid时返回PID_NO_TASK
+ * @note 需持有tasks_lock
+ */
+PRIVATE pid_t pid_alloc(void)
+{
+    uint64_t *bitmap = global_task_man->pid_bitmap;
+    uint32_t  words  = TASKS / 64;
+    uint32_t  start  = global_task_man->next_pid / 64;
+    uint32_t  i;
+    for (i = 0; i <= words; i++)
+    {
+        uint32_t word = (start + i) % words;
+        uint64_t free = ~bitmap[word];
+        // 第一次只查找next_pid之后的位,最后一次(回到起始位置)查找全部
+        if (i == 0)
+        {
+            free &= ~0ULL << (global_task_man->next_pid % 64);
+        }
+        if (free == 0)
+        {
+            continue;
+        }
+        pid_t pid = word * 64 + __builtin_ctzll(free);
+        bitmap[word] |= 1ULL << (pid % 64);
+        global_task_man->next_pid = (pid + 1) % TASKS;
+        return pid;
+    }
+    return PID_NO_TASK;
+}
+
+/**
+ * @brief 将pid标记为未使用
+ * @note 需持有tasks_lock
+ */
+PRIVATE void pid_free(pid_t pid)
+{
+    global_task_man->pid_bitmap[pid / 64] &= ~(1ULL << (pid % 64));
+    return;
+}
+
 PUBLIC task_struct_t *task_alloc(void)
 {
     task_struct_t *task = NULL;
+
+    // tasks_lock可能在中断中(inform_intr的task_get)获取,持有时需关闭中断
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&global_task_man->tasks_lock);
+    if (!list_empty(&global_task_man->free_tasks))
+    {
+        list_node_t *node = list_pop(&global_task_man->free_tasks);
+        task              = CONTAINER_OF(task_struct_t, general_tag, node);
+    }
+    spinlock_unlock(&global_task_man->tasks_lock);
+    intr_set_status(intr_status);
+
+    if (task == NULL &&
+        ERROR(kmalloc(sizeof(*task), CACHE_LINE_SIZE, 0, &task)))
+    {
+        return NULL;
+    }
+    memset(task, 0, sizeof(*task));
+
+    intr_status = intr_disable();
     spinlock_lock(&global_task_man->tasks_lock);
-    pid_t i;
-    for (i = 0; i < TASKS; i++)
+    pid_t           pid   = pid_alloc();
+    task_struct_t **entry = NULL;
+    if (pid != PID_NO_TASK)
     {
-        if (global_task_man->tasks[i].pid == PID_NO_TASK)
+        entry = pid_map_entry(pid, TRUE);
+        if (entry == NULL)
         {
-            task = &global_task_man->tasks[i];
-            memset(task, 0, sizeof(*task));
-            task->pid = i;
-            break;
+            pid_free(pid);
         }
     }
+    if (entry != NULL)
+    {
+        task->pid  = pid;
+        task->refs = 1; // pid_map持有的引用
+        *entry     = task;
+    }
     spinlock_unlock(&global_task_man->tasks_lock);
+    intr_set_status(intr_status);
+
+    if (entry == NULL)
+    {
+        kfree(task);
+        return NULL;
+    }
     return task;
 }
 
@@ -105,40 +227,61 @@ PUBLIC void task_free(task_struct_t *task)
     {
         return;
     }
+    intr_status_t intr_status = intr_disable();
     spinlock_lock(&global_task_man->tasks_lock);
-    task->pid = PID_NO_TASK;
+    *pid_map_entry(task->pid, FALSE) = NULL;
+    pid_free(task->pid);
     spinlock_unlock(&global_task_man->tasks_lock);
+    intr_set_status(intr_status);
+    // 释放pid_map持有的引用,通过task_get获取的指针在task_put前仍然有效
+    task_put(task);
     return;
 }
 
-PRIVATE void main_task_adopt_child(pid_t ppid)
+PUBLIC void task_add_child(task_struct_t *parent, task_struct_t *child)
 {
-    task_struct_t *child_task;
-    task_man_t    *child_task_man;
+    spinlock_lock(&parent->child_list_lock);
+    child->ppid = parent->pid;
+    // 子任务继承父任务的任务组
+    task_group_inherit(child, parent);
+    list_append(&parent->child_list, &child->child_tag);
+    atomic_inc(&parent->childs);
+    spinlock_unlock(&parent->child_list_lock);
+    return;
+}
 
-    task_struct_t *parent_task = pid_to_task(ppid);
+PRIVATE void main_task_adopt_child(task_struct_t *parent_task)
+{
+    task_struct_t *child_task;
+    task_struct_t *main_task;
+    list_node_t   *node;
 
     // 防止在此期间还有子任务退出
     spinlock_lock(&parent_task->child_list_lock);
-    pid_t i;
-    for (i = MIN_PID; i <= MAX_PID; i++)
+    while (!list_empty(&parent_task->child_list))
     {
-        child_task = pid_to_task(i);
-        if (child_task != NULL && child_task->ppid == ppid)
-        {
-            child_task_man   = get_task_man(child_task->cpu_id);
-            child_task->ppid = child_task_man->main_task->pid;
-        }
+        node       = list_pop(&parent_task->child_list);
+        child_task = CONTAINER_OF(task_struct_t, child_tag, node);
+        main_task  = get_task_man(child_task->cpu_id)->main_task;
+
+        spinlock_lock(&main_task->child_list_lock);
+        child_task->ppid = main_task->pid;
+        list_append(&main_task->child_list, node);
+        atomic_inc(&main_task->childs);
+        spinlock_unlock(&main_task->child_list_lock);
+        atomic_dec(&parent_task->childs);
     }
-    // 已退出的子任务也转给main_task
+    // 已退出的子任务也转给新的父任务
     while (!list_empty(&parent_task->exited_child_list))
     {
-        list_node_t *node = list_pop(&parent_task->exited_child_list);
-        child_task        = CONTAINER_OF(task_struct_t, general_tag, node);
-        child_task_man    = get_task_man(child_task->cpu_id);
-        spinlock_lock(&child_task_man->main_task->child_list_lock);
-        list_append(&child_task_man->main_task->exited_child_list, node);
-        spinlock_unlock(&child_task_man->main_task->child_list_lock);
+        node       = list_pop(&parent_task->exited_child_list);
+        child_task = CONTAINER_OF(task_struct_t, general_tag, node);
+        main_task  = pid_to_task(child_task->ppid);
+
+        spinlock_lock(&main_task->child_list_lock);
+        list_append(&main_task->exited_child_list, node);
+        spinlock_unlock(&main_task->child_list_lock);
+        task_wakeup(main_task, TASK_WAITING);
     }
     spinlock_unlock(&parent_task->child_list_lock);
     return;
@@ -152,6 +295,8 @@ PUBLIC status_t init_task_struct(
     size_t         kstack_size
 )
 {
+    pid_t    pid  = task->pid; // pid与引用计数由task_alloc设置
+    uint64_t refs = task->refs;
     memset(task, 0, sizeof(*task));
     task->context     = (task_context_t *)(kstack_base + kstack_size);
     task->kstack_base = kstack_base;
@@ -160,7 +305,8 @@ PUBLIC status_t init_task_struct(
     task->ustack_base = 0;
     task->ustack_size = 0;
 
-    task->pid  = task_to_pid(task);
+    task->pid  = pid;
+    task->refs = refs;
     task->ppid = running_task()->pid;
 
     strncpy(task->name, name, 31);
@@ -170,22 +316,60 @@ PUBLIC status_t init_task_struct(
     task->preempt_count = 0;
     task->cpu_id        = running_task()->cpu_id;
     task->page_dir      = NULL;
-
-    task->priority  = priority;
-    task->run_time  = 0;
-    task->vrun_time = 0; // 将由task_update设置
-
-    task->send_to   = PID_NO_TASK;
-    task->recv_from = PID_NO_TASK;
-    atomic_set(&task->send_flag, 0);
-    atomic_set(&task->recv_flag, 0);
+    task->mm_id         = 0;
+    task->tlb_gen       = 0;
+    task->pcid          = 0;
+
+    memset(&task->cpus_allowed, 0xff, sizeof(task->cpus_allowed));
+
+    task->priority       = priority;
+    task->run_time       = 0;
+    task->slice_run_time = 0;
+
+    // vrun_time与deadline将在加入就绪队列时设置
+    memset(&task->se, 0, sizeof(task->se));
+    task->se.weight = sched_prio_to_weight(priority);
+    task->se.slice  = SCHED_BASE_SLICE;
+    task->group     = NULL;
+
+    task->policy        = SCHED_NORMAL;
+    task->rt_priority   = 0;
+    task->rt_slice_left = 0;
+
+    task->dl_runtime      = 0;
+    task->dl_deadline     = 0;
+    task->dl_period       = 0;
+    task->dl_bw           = 0;
+    task->dl_budget       = 0;
+    task->dl_abs_deadline = 0;
+    task->dl_throttled    = FALSE;
+
+    task->exec_start  = read_tsc();
+    task->wait_start  = task->exec_start;
+    task->user_time   = 0;
+    task->kernel_time = 0;
+    task->wait_time   = 0;
+
+    memset(&task->sched_stat, 0, sizeof(task->sched_stat));
+    task->stat_status       = task->status;
+    task->stat_status_start = task->exec_start;
+    task->wakeup_start      = 0;
+
+    task->send_to       = PID_NO_TASK;
+    task->recv_from     = PID_NO_TASK;
+    task->recv_buf      = NULL;
+    task->ipc_delivered = FALSE;
+
+    init_spinlock(&task->vmm_lock);
 
     task->has_intr_msg = 0;
     init_spinlock(&task->send_lock);
     init_list(&task->sender_list);
+    mailbox_init(&task->mailbox);
 
     atomic_set(&task->childs, 0);
     init_spinlock(&task->child_list_lock);
+    init_list(&task->child_list);
     init_list(&task->exited_child_list);
     task->return_status = 0;
 
@@ -196,7 +380,12 @@ PUBLIC status_t init_task_struct(
     {
         return status;
     }
-    task->fxsave_region = fxsave_region;
+    // 初始FPU/SSE状态: FCW = 0x037f, MXCSR = 0x1f80
+    memset(fxsave_region, 0, sizeof(*fxsave_region));
+    *(uint16_t *)&(*fxsave_region)[0]  = 0x037f;
+    *(uint32_t *)&(*fxsave_region)[24] = 0x1f80;
+    task->fxsave_region                = fxsave_region;
+    task->fpu_cpu                      = NR_CPUS;
     return K_SUCCESS;
 }
 
@@ -242,13 +431,9 @@ PUBLIC task_struct_t *task_start(
     init_task_struct(task, name, priority, kstack_base, kstack_size);
     create_task_struct(task, func, arg);
 
-    task_struct_t *parent_task = pid_to_task(task->ppid);
-    atomic_inc(&parent_task->childs);
+    task_add_child(running_task(), task);
 
-    task_man_t *task_man = get_task_man(task->cpu_id);
-    spinlock_lock(&task_man->task_list_lock);
-    task_list_insert(task_man, task);
-    spinlock_unlock(&task_man->task_list_lock);
+    task_unblock(task->pid);
     return task;
 }
 
@@ -259,7 +444,7 @@ PUBLIC void task_exit(int status)
 
     /// TODO: 处理未完成的IPC
 
-    main_task_adopt_child(task->pid);
+    main_task_adopt_child(task);
     // 通知父进程任务退出
     task_block(TASK_DIED);
     return;
@@ -279,23 +464,57 @@ PUBLIC int task_release_resource(pid_t pid)
     task_struct_t *task        = pid_to_task(pid);
     task_struct_t *parent_task = pid_to_task(task->ppid);
     ASSERT(parent_task->pid == running_task()->pid);
+
+    // 任务在通知父任务后才切换出去,需等待其不再使用内核栈
+    while (task->on_cpu) continue;
+
     kfree(task->fxsave_region);
     kfree((void *)task->kstack_base);
 
     // 获取返回值
     int return_status = task->return_status;
 
+    spinlock_lock(&parent_task->child_list_lock);
+    list_remove(&task->child_tag);
+    spinlock_unlock(&parent_task->child_list_lock);
     atomic_dec(&parent_task->childs);
 
+    // 撤销进程退出后才授予它的共享内存,pid被重新分配后不能再映射
+    shm_task_exit(task);
+    task_group_exit(task);
     task_free(task);
     return return_status;
 }
 
 PRIVATE void idle_task()
 {
+    task_man_t *task_man = get_task_man(running_task()->cpu_id);
     while (1)
     {
-        task_block(TASK_BLOCKED);
+        intr_disable();
+        // 有任务可运行时切换到该任务,否则尝试从其他cpu拉取任务
+        schedule();
+
+        spinlock_lock(&task_man->task_list_lock);
+        bool empty     = task_list_empty(task_man);
+        bool throttled = task_man->dl_nr_throttled != 0;
+        spinlock_unlock(&task_man->task_list_lock);
+        if (!empty)
+        {
+            continue;
+        }
+        // 就绪队列为空: 停止周期性时钟,在下一个定时器到期或被IPI唤醒前休眠.
+        // sti与hlt之间不会响应中断,因此检查就绪队列后到达的唤醒不会丢失.
+        // 有被限制的deadline任务时保留周期性时钟,由时钟中断补充其预算
+        if (throttled)
+        {
+            tick_nohz_idle_exit();
+        }
+        else
+        {
+            tick_nohz_idle_enter();
+        }
+        io_stihlt();
     }
     return;
 }
@@ -316,7 +535,11 @@ PRIVATE void make_main_task(void)
         KERNEL_STACK_SIZE
     );
     main_task->status   = TASK_RUNNING; // main_task已经在运行
+    main_task->on_cpu   = TRUE;
+    memset(&main_task->cpus_allowed, 0, sizeof(main_task->cpus_allowed));
+    CPUMASK_SET(&main_task->cpus_allowed, main_task->cpu_id);
     task_man->main_task = main_task;
+    task_man->curr      = main_task;
     return;
 }
 
@@ -328,6 +551,10 @@ PUBLIC void create_idle_task(void)
     task_struct_t *idle = task_start("idle", IDLE_PRIORITY, 4096, idle_task, 0);
     task_man->idle_task = idle;
 
+    // idle不会被负载均衡迁移,限制在此cpu上只是为了保持cpus_allowed的含义
+    memset(&idle->cpus_allowed, 0, sizeof(idle->cpus_allowed));
+    CPUMASK_SET(&idle->cpus_allowed, task_man->cpu_id);
+
     return;
 }
 
@@ -341,29 +568,67 @@ PUBLIC void task_init(void)
 
     global_task_man = PHYS_TO_VIRT(addr);
     memset(global_task_man, 0, sizeof(*global_task_man));
+    global_task_man->next_pid = MIN_PID;
     int i;
-    for (i = 0; i < TASKS; i++)
-    {
-        global_task_man->tasks[i].pid = PID_NO_TASK;
-    }
     for (i = 0; i < NR_CPUS; i++)
     {
         task_man_t *task_man = &global_task_man->cpus[i];
 
-        init_list(&task_man->task_list);
+        init_cfs_rq(&task_man->cfs, NULL);
         init_spinlock(&task_man->task_list_lock);
 
-        init_list(&task_man->waiting_list);
-
-        task_man->min_vrun_time = 0;
         task_man->running_tasks = 0;
         task_man->total_weight  = 0;
         task_man->main_task     = NULL;
         task_man->idle_task     = NULL;
+
+        task_man->cpu_id       = i;
+        task_man->curr         = NULL;
+        task_man->prev_task    = NULL;
+        task_man->next_balance = 0;
+        task_man->need_resched = FALSE;
+        memset(&task_man->avg, 0, sizeof(task_man->avg));
+
+        init_rbtree(&task_man->dl_tree);
+        init_rbtree(&task_man->dl_throttle_tree);
+        task_man->dl_running      = 0;
+        task_man->dl_nr_throttled = 0;
+        task_man->dl_bw           = 0;
+
+        int j;
+        for (j = 0; j < RT_PRIORITIES; j++)
+        {
+            init_list(&task_man->rt_queue[j]);
+        }
+        task_man->rt_bitmap       = 0;
+        task_man->rt_running      = 0;
+        task_man->rt_time         = 0;
+        task_man->rt_period_start = 0;
+        task_man->rt_throttled    = FALSE;
+
+        task_man->fpu_owner    = NULL;
+        task_man->fpu_in_use   = FALSE;
+        task_man->fpu_switches = 0;
+        task_man->fpu_saves    = 0;
+        task_man->fpu_restores = 0;
+
+        memset(&task_man->sched_stat, 0, sizeof(task_man->sched_stat));
+
+        // 未知cr3中的页表,第一次激活页表时总是写入cr3
+        task_man->cr3_page_dir = NULL;
+        task_man->pcid_enabled = FALSE;
+        task_man->pcid_next    = 1;
+        task_man->pcid_gen     = 1; // gen为0的PCID未被分配
+        task_man->mm_seq       = 0;
+        memset(task_man->pcids, 0, sizeof(task_man->pcids));
     }
     init_spinlock(&global_task_man->tasks_lock);
+    init_list(&global_task_man->free_tasks);
+    init_spinlock(&global_task_man->groups_lock);
 
     make_main_task();
+    fpu_init();
+    fpu_cpu_init();
     create_idle_task();
     return;
 }
\ No newline at end of file
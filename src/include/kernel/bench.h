@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/**
+ * Copyright (C) 2025 LinChenjun
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+/**
+ * @brief 启动配置项BENCHMARK中列出的基准测试
+ * @note 在BSP上init_all()完成后调用,配置项的值以','分隔,例如:
+ *       BENCHMARK = [ipc]
+ */
+PUBLIC void bench_start(void);
+
+/**
+ * @brief 启动基准测试在AP上需要的任务
+ * @note 在AP上ap_init_all()完成后调用
+ */
+PUBLIC void bench_ap_start(void);
+
+#endif
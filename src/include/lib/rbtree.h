@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/**
+ * Copyright (C) 2024-2025 LinChenjun
+ */
+
+#ifndef __RBTREE_H__
+#define __RBTREE_H__
+
+#define RBTREE_RED   0
+#define RBTREE_BLACK 1
+
+typedef struct rbtree_node_s rbtree_node_t;
+
+struct rbtree_node_s
+{
+    rbtree_node_t *parent;
+    rbtree_node_t *left;
+    rbtree_node_t *right;
+    int            color;
+};
+
+typedef struct rbtree_s
+{
+    rbtree_node_t *root;
+    rbtree_node_t *leftmost; // 缓存的最左(最小)节点
+
+    // 根据节点自身与其子节点重新计算节点中附加的子树信息,可以为NULL
+    void (*augment)(rbtree_node_t *node);
+} rbtree_t;
+
+PUBLIC void init_rbtree(rbtree_t *tree);
+
+/**
+ * @brief 初始化附加了子树信息的红黑树
+ * @param tree 红黑树
+ * @param augment 重新计算节点子树信息的函数
+ * @note 插入、删除与旋转时,所有子树发生变化的节点都会调用augment,
+ *       调用时其子节点的信息已经是最新的
+ */
+PUBLIC void
+init_rbtree_augmented(rbtree_t *tree, void (*augment)(rbtree_node_t *node));
+
+/**
+ * @brief 将节点插入红黑树
+ * @param tree 红黑树
+ * @param node 要插入的节点
+ * @param less 比较函数,当a应排在b之前时返回true
+ * @note 与已有节点相等的节点将插入到这些节点之后
+ */
+PUBLIC void rbtree_insert(
+    rbtree_t      *tree,
+    rbtree_node_t *node,
+    bool (*less)(rbtree_node_t *a, rbtree_node_t *b)
+);
+
+/**
+ * @brief 将节点从红黑树中删除
+ * @param tree 红黑树
+ * @param node 要删除的节点(必须在树中)
+ */
+PUBLIC void rbtree_remove(rbtree_t *tree, rbtree_node_t *node);
+
+/**
+ * @brief 获取树中最小的节点
+ * @param tree 红黑树
+ * @return 最小的节点,树为空时返回NULL
+ * @note 使用缓存的最左节点,时间复杂度O(1)
+ */
+PUBLIC rbtree_node_t *rbtree_first(rbtree_t *tree);
+
+/**
+ * @brief 获取中序遍历时的下一个节点
+ * @param node 当前节点
+ * @return 下一个节点,没有时返回NULL
+ */
+PUBLIC rbtree_node_t *rbtree_next(rbtree_node_t *node);
+
+PUBLIC bool rbtree_empty(rbtree_t *tree);
+
+#endif
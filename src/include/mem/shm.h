@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/**
+ * Copyright (C) 2025 LinChenjun
+ */
+
+#ifndef __SHM_H__
+#define __SHM_H__
+
+#include <task/task.h> // task_struct_t
+
+// 共享内存区域的数量
+#define SHM_REGIONS 64
+
+// 每个共享内存区域最多的页数
+#define SHM_MAX_PAGES 8
+
+// 每个共享内存区域最多可授权的任务数(包括创建者)
+#define SHM_MAPS 8
+
+PUBLIC void shm_init(void);
+
+/**
+ * @brief 创建共享内存区域,并映射到task的地址空间中
+ * @param task 创建者(当前任务)
+ * @param size 区域大小,按页向上取整
+ * @param handle 成功时存储区域的句柄
+ * @param vaddr 成功时存储区域在task中的地址
+ * @return 成功返回K_SUCCESS
+ */
+PUBLIC status_t shm_region_create(
+    task_struct_t *task,
+    size_t         size,
+    uint64_t      *handle,
+    uintptr_t     *vaddr
+);
+
+/**
+ * @brief 允许pid映射共享内存区域
+ * @param task 区域的创建者(当前任务)
+ * @param handle 区域的句柄
+ * @param pid 被授权的任务,需为存在的进程(内核任务没有页表,不能被授权)
+ * @return 成功返回K_SUCCESS
+ */
+PUBLIC status_t
+shm_region_grant(task_struct_t *task, uint64_t handle, pid_t pid);
+
+/**
+ * @brief 将已授权的共享内存区域映射到task的地址空间中
+ * @param task 创建者或被授权的任务(当前任务)
+ * @param handle 区域的句柄
+ * @param vaddr 成功时存储区域在task中的地址,已映射时返回原来的地址
+ * @param pages 成功时存储区域的页数
+ * @return 成功返回K_SUCCESS
+ * @note 创建者解除映射或退出后返回K_INVALID_PARAM(即使task已映射),
+ *       其他任务应解除映射,以便释放区域
+ */
+PUBLIC status_t shm_region_map(
+    task_struct_t *task,
+    uint64_t       handle,
+    uintptr_t     *vaddr,
+    uint64_t      *pages
+);
+
+/**
+ * @brief 解除task对共享内存区域的映射
+ * @param task 当前任务
+ * @param handle 区域的句柄
+ * @return 成功返回K_SUCCESS
+ * @note 最后一个映射被解除后释放区域的物理页
+ */
+PUBLIC status_t shm_region_unmap(task_struct_t *task, uint64_t handle);
+
+/**
+ * @brief 获取task已映射的共享内存区域在内核中的地址,并增加区域的引用
+ * @param task 已映射该区域的任务(当前任务)
+ * @param handle 区域的句柄
+ * @param kaddr 成功时存储区域在内核中的地址
+ * @param size 成功时存储区域的大小
+ * @return 成功返回K_SUCCESS
+ * @note 任务解除映射或退出后区域仍然有效,直到调用shm_region_put
+ */
+PUBLIC status_t shm_region_get(
+    task_struct_t *task,
+    uint64_t       handle,
+    void         **kaddr,
+    size_t        *size
+);
+
+/**
+ * @brief 释放shm_region_get获取的引用,最后一个引用被释放后释放区域
+ * @param handle 区域的句柄
+ */
+PUBLIC void shm_region_put(uint64_t handle);
+
+/**
+ * @brief 进程退出时解除其所有共享内存映射,并撤销对它的授权
+ * @param task 退出的进程
+ * @note 需在free_page_table前调用,以免共享的物理页随页表被释放.
+ *       回收进程时会再次调用,撤销在此之后授予它的区域
+ */
+PUBLIC void shm_task_exit(task_struct_t *task);
+
+#endif
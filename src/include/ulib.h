@@ -10,6 +10,31 @@ PUBLIC pid_t waitpid(pid_t pid, int *status, int options);
 PUBLIC void *allocate_page(void);
 PUBLIC void  free_page(void *addr);
 PUBLIC void  read_task_addr(pid_t pid, void *addr, size_t size, void *buffer);
+PUBLIC int   set_scheduler(pid_t pid, uint32_t policy, uint32_t rt_priority);
+PUBLIC int   set_sched_slice(pid_t pid, uint64_t slice);
+PUBLIC int   set_affinity(pid_t pid, const uint64_t *mask);
+PUBLIC int   get_affinity(pid_t pid, uint64_t *mask);
+PUBLIC int   create_sched_group(uint64_t weight);
+PUBLIC int   set_sched_group(pid_t pid, uint32_t id);
+PUBLIC int
+set_deadline(pid_t pid, uint64_t runtime, uint64_t deadline, uint64_t period);
+PUBLIC int get_task_stat(pid_t pid, task_sched_stat_t *stat);
+PUBLIC int get_cpu_stat(uint32_t cpu_id, cpu_sched_stat_t *stat);
+
+PUBLIC void *shm_create(size_t size, uint64_t *handle);
+PUBLIC int   shm_grant(uint64_t handle, pid_t pid);
+PUBLIC void *shm_map(uint64_t handle, size_t *size);
+PUBLIC int   shm_unmap(uint64_t handle);
+
+PUBLIC int ring_setup(uint64_t handle, uint64_t entries, uint64_t flags);
+PUBLIC int ring_enter(void);
+PUBLIC int ring_submit(
+    kernel_ring_t   *ring,
+    uint64_t         entries,
+    uint64_t         user_data,
+    const message_t *msg
+);
+PUBLIC int ring_reap(kernel_ring_t *ring, uint64_t entries, ring_cqe_t *cqe);
 
 PUBLIC uint64_t get_ticks(void);
 
@@ -22,4 +47,13 @@ PUBLIC void fill(
     uint32_t y
 );
 
+PUBLIC int fill_shm(
+    uint64_t handle,
+    size_t   offset,
+    uint32_t xsize,
+    uint32_t ysize,
+    uint32_t x,
+    uint32_t y
+);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,450 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/**
+ * Copyright (C) 2025 LinChenjun
+ */
+
+#include <kernel/global.h>
+
+#include <log.h>
+
+#include <config.h>         // read_config
+#include <device/pic.h>     // apic
+#include <device/timer.h>   // tsc_to_ns
+#include <intr.h>           // intr_disable,intr_set_status
+#include <io.h>             // read_tsc
+#include <kernel/bench.h>   // bench_start,bench_ap_start
+#include <kernel/syscall.h> // sys_send_recv
+#include <std/string.h>     // memset,strlen,strncmp
+#include <task/task.h>      // task_start,running_task,task_msleep
+
+extern apic_t apic;
+
+// 跨核IPC测试中回显任务所在的cpu
+#define BENCH_IPC_ECHO_CPU 1
+
+// 跨核IPC测试的往返次数
+#define BENCH_IPC_ROUNDS 10000
+
+// 唤醒延迟测试中每个cpu上占用cpu的任务数
+#define BENCH_WAKEUP_HOGS_PER_CPU 2
+
+// 唤醒延迟测试中每种策略的采样次数
+#define BENCH_WAKEUP_ROUNDS 2000
+
+// 唤醒延迟测试中作为延迟提示请求的时间片(ns)
+#define BENCH_WAKEUP_SLICE 500000
+
+// 任务切换测试的往返次数
+#define BENCH_SWITCH_ROUNDS 10000
+
+// 调用与回复测试的往返次数
+#define BENCH_CALL_ROUNDS 10000
+
+typedef struct bench_s
+{
+    const char *name;
+    void (*func)(void);
+} bench_t;
+
+typedef struct bench_stat_s
+{
+    uint64_t count;
+    uint64_t total; // ns
+    uint64_t min;   // ns
+    uint64_t max;   // ns
+} bench_stat_t;
+
+PRIVATE void bench_ipc(void);
+PRIVATE void bench_wakeup(void);
+PRIVATE void bench_switch(void);
+PRIVATE void bench_call(void);
+
+PRIVATE bench_t benches[] = {
+    { "ipc", bench_ipc },
+    { "wakeup", bench_wakeup },
+    { "switch", bench_switch },
+    { "call", bench_call },
+};
+
+PRIVATE volatile pid_t ipc_echo_pid = PID_NO_TASK;
+
+PRIVATE volatile bool  wakeup_stop = FALSE;
+PRIVATE volatile pid_t wakeup_pid  = PID_NO_TASK;
+PRIVATE bench_stat_t   wakeup_stat;
+
+PRIVATE task_struct_t *volatile switch_main = NULL;
+PRIVATE volatile bool           switch_stop = FALSE;
+
+PRIVATE volatile pid_t call_server_pid = PID_NO_TASK;
+
+PRIVATE bool bench_enabled(const char *name)
+{
+    char   list[64];
+    size_t len      = 63;
+    size_t name_len = strlen(name);
+    read_config("BENCHMARK", list, &len);
+
+    size_t i = 0;
+    while (i < len)
+    {
+        size_t j = i;
+        while (j < len && list[j] != ',') j++;
+        if (j - i == name_len && strncmp(&list[i], name, name_len) == 0)
+        {
+            return TRUE;
+        }
+        i = j + 1;
+    }
+    return FALSE;
+}
+
+PRIVATE void stat_init(bench_stat_t *stat)
+{
+    stat->count = 0;
+    stat->total = 0;
+    stat->min   = (uint64_t)-1;
+    stat->max   = 0;
+    return;
+}
+
+PRIVATE void stat_add(bench_stat_t *stat, uint64_t ns)
+{
+    stat->count++;
+    stat->total += ns;
+    stat->min = MIN(stat->min, ns);
+    stat->max = MAX(stat->max, ns);
+    return;
+}
+
+PRIVATE void stat_print(const char *name, bench_stat_t *stat)
+{
+    if (stat->count == 0)
+    {
+        PR_LOG(LOG_INFO, "%s: no samples.\n", name);
+        return;
+    }
+    PR_LOG(
+        LOG_INFO,
+        "%s: n=%lu avg=%luns min=%luns max=%luns\n",
+        name,
+        stat->count,
+        stat->total / stat->count,
+        stat->min,
+        stat->max
+    );
+    return;
+}
+
+PRIVATE void ipc_echo_task(void)
+{
+    message_t msg;
+    ipc_echo_pid = running_task()->pid;
+    while (1)
+    {
+        sys_send_recv(NR_RECV, RECV_FROM_ANY, &msg);
+        pid_t src = msg.src;
+        msg.m[0]  = running_task()->cpu_id;
+        sys_send_recv(NR_SEND, src, &msg);
+    }
+}
+
+/**
+ * @brief 测量IPC往返延迟(发送请求并等待回显任务的回复)
+ * @note 按双方是否在同一cpu上分别统计
+ */
+PRIVATE void bench_ipc(void)
+{
+    while (ipc_echo_pid == PID_NO_TASK)
+    {
+        task_msleep(10);
+    }
+
+    bench_stat_t cross_core;
+    bench_stat_t same_core;
+    stat_init(&cross_core);
+    stat_init(&same_core);
+
+    message_t msg;
+    int       i;
+    for (i = 0; i < BENCH_IPC_ROUNDS; i++)
+    {
+        memset(&msg, 0, sizeof(msg));
+        uint64_t start = read_tsc();
+        sys_send_recv(NR_BOTH, ipc_echo_pid, &msg);
+        uint64_t ns = tsc_to_ns(read_tsc() - start);
+
+        bool same = msg.m[0] == running_task()->cpu_id;
+        stat_add(same ? &same_core : &cross_core, ns);
+    }
+    stat_print("ipc round trip (cross core)", &cross_core);
+    stat_print("ipc round trip (same core)", &same_core);
+    return;
+}
+
+PRIVATE void cpu_hog_task(void)
+{
+    while (!wakeup_stop) continue;
+    return;
+}
+
+PRIVATE void wakeup_sleeper_task(void)
+{
+    message_t msg;
+    wakeup_pid = running_task()->pid;
+    while (1)
+    {
+        sys_send_recv(NR_RECV, RECV_FROM_ANY, &msg);
+        // m[0]: 发送时的TSC值, m[1]: 非0时结束测试
+        if (msg.m[1] != 0)
+        {
+            break;
+        }
+        stat_add(&wakeup_stat, tsc_to_ns(read_tsc() - msg.m[0]));
+    }
+    return;
+}
+
+/**
+ * @brief 每隔1ms唤醒一次接收任务,测量从发送消息到接收任务开始运行的时间
+ * @param name 统计结果的名称
+ * @param eevdf 是否使用EEVDF
+ * @param slice 接收任务请求的时间片(ns),0表示默认值
+ */
+PRIVATE void bench_wakeup_round(const char *name, bool eevdf, uint64_t slice)
+{
+    sched_set_eevdf(eevdf);
+    stat_init(&wakeup_stat);
+    wakeup_pid = PID_NO_TASK;
+
+    task_struct_t *sleeper = task_start(
+        "wakeup sleeper",
+        DEFAULT_PRIORITY,
+        4096,
+        wakeup_sleeper_task,
+        0
+    );
+    task_set_slice(sleeper, slice);
+    while (wakeup_pid == PID_NO_TASK)
+    {
+        task_msleep(1);
+    }
+
+    message_t msg;
+    int       i;
+    for (i = 0; i < BENCH_WAKEUP_ROUNDS; i++)
+    {
+        task_msleep(1);
+        memset(&msg, 0, sizeof(msg));
+        msg.m[0] = read_tsc();
+        sys_send_recv(NR_SEND, wakeup_pid, &msg);
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.m[1] = 1;
+    sys_send_recv(NR_SEND, wakeup_pid, &msg);
+
+    stat_print(name, &wakeup_stat);
+    return;
+}
+
+/**
+ * @brief 在所有cpu都有计算任务的情况下,比较不同策略下的唤醒延迟
+ */
+PRIVATE void bench_wakeup(void)
+{
+    wakeup_stop = FALSE;
+    int hogs    = apic.number_of_cores * BENCH_WAKEUP_HOGS_PER_CPU;
+    int i;
+    for (i = 0; i < hogs; i++)
+    {
+        task_start("cpu hog", DEFAULT_PRIORITY, 4096, cpu_hog_task, 0);
+    }
+
+    bench_wakeup_round("wakeup latency (vrun_time)", FALSE, 0);
+    bench_wakeup_round("wakeup latency (eevdf)", TRUE, 0);
+    bench_wakeup_round(
+        "wakeup latency (eevdf, short slice)",
+        TRUE,
+        BENCH_WAKEUP_SLICE
+    );
+
+    wakeup_stop = TRUE;
+    sched_set_eevdf(TRUE);
+    return;
+}
+
+/**
+ * @brief 唤醒另一个任务后阻塞,两个任务在同一cpu上交替运行
+ * @param task 要唤醒的任务
+ * @note 关闭中断,以免在唤醒与阻塞之间被抢占而丢失唤醒
+ */
+PRIVATE void switch_handoff(task_struct_t *task)
+{
+    intr_status_t intr_status = intr_disable();
+    task_wakeup(task, TASK_BLOCKED);
+    task_block(TASK_BLOCKED);
+    intr_set_status(intr_status);
+    return;
+}
+
+PRIVATE void switch_peer_task(void)
+{
+    task_block(TASK_BLOCKED);
+    while (!switch_stop)
+    {
+        switch_handoff(switch_main);
+    }
+    return;
+}
+
+/**
+ * @brief 测量同一cpu上两个内核任务之间的切换时间
+ * @note 每一轮包括两次阻塞,唤醒与任务切换
+ */
+PRIVATE void bench_switch(void)
+{
+    task_struct_t *cur = running_task();
+    cpumask_t      mask;
+    cpumask_t      old_mask = cur->cpus_allowed;
+    memset(&mask, 0, sizeof(mask));
+    CPUMASK_SET(&mask, cur->cpu_id);
+    task_set_affinity(cur, &mask);
+
+    switch_main = cur;
+    switch_stop = FALSE;
+    task_struct_t *peer =
+        task_start("switch peer", DEFAULT_PRIORITY, 4096, switch_peer_task, 0);
+    task_set_affinity(peer, &mask);
+    while (peer->status != TASK_BLOCKED || peer->on_cpu)
+    {
+        task_yield();
+    }
+
+    bench_stat_t stat;
+    stat_init(&stat);
+    int i;
+    for (i = 0; i < BENCH_SWITCH_ROUNDS; i++)
+    {
+        uint64_t start = read_tsc();
+        switch_handoff(peer);
+        stat_add(&stat, tsc_to_ns(read_tsc() - start));
+    }
+    switch_stop = TRUE;
+    task_wakeup(peer, TASK_BLOCKED);
+
+    stat_print("context switch round trip", &stat);
+    PR_LOG(
+        LOG_INFO,
+        "context switch: %luns per switch\n",
+        stat.total / (2 * BENCH_SWITCH_ROUNDS)
+    );
+    task_set_affinity(cur, &old_mask);
+    return;
+}
+
+PRIVATE void call_server_task(void)
+{
+    message_t msg;
+    call_server_pid = running_task()->pid;
+    while (1)
+    {
+        sys_send_recv(NR_RECV, RECV_FROM_ANY, &msg);
+        // m[0]: 非0时结束测试
+        if (msg.m[0] != 0)
+        {
+            break;
+        }
+        pid_t src = msg.src;
+        sys_send_recv(NR_SEND, src, &msg);
+    }
+    return;
+}
+
+/**
+ * @brief 测量同一cpu上调用与回复的往返时间
+ * @note 调用方使用NR_BOTH,服务任务已在等待消息时,
+ *       消息直接复制到服务任务的缓冲区,并且不经过就绪队列直接切换过去
+ */
+PRIVATE void bench_call(void)
+{
+    task_struct_t *cur = running_task();
+    cpumask_t      mask;
+    cpumask_t      old_mask = cur->cpus_allowed;
+    memset(&mask, 0, sizeof(mask));
+    CPUMASK_SET(&mask, cur->cpu_id);
+    task_set_affinity(cur, &mask);
+
+    call_server_pid = PID_NO_TASK;
+    task_struct_t *server =
+        task_start("call server", DEFAULT_PRIORITY, 4096, call_server_task, 0);
+    task_set_affinity(server, &mask);
+    while (call_server_pid == PID_NO_TASK)
+    {
+        task_msleep(1);
+    }
+
+    bench_stat_t stat;
+    message_t    msg;
+    stat_init(&stat);
+    int i;
+    for (i = 0; i < BENCH_CALL_ROUNDS; i++)
+    {
+        memset(&msg, 0, sizeof(msg));
+        uint64_t start = read_tsc();
+        sys_send_recv(NR_BOTH, call_server_pid, &msg);
+        stat_add(&stat, tsc_to_ns(read_tsc() - start));
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.m[0] = 1;
+    sys_send_recv(NR_SEND, call_server_pid, &msg);
+
+    stat_print("ipc call round trip", &stat);
+    task_set_affinity(cur, &old_mask);
+    return;
+}
+
+PRIVATE void bench_main(void)
+{
+    size_t i;
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+    {
+        if (bench_enabled(benches[i].name))
+        {
+            PR_LOG(LOG_INFO, "benchmark: %s\n", benches[i].name);
+            benches[i].func();
+        }
+    }
+    return;
+}
+
+PUBLIC void bench_start(void)
+{
+    size_t i;
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+    {
+        if (bench_enabled(benches[i].name))
+        {
+            break;
+        }
+    }
+    if (i == sizeof(benches) / sizeof(benches[0]))
+    {
+        return;
+    }
+
+    // 单核时回显任务与测试任务在同一cpu上
+    if (bench_enabled("ipc") && apic.number_of_cores <= BENCH_IPC_ECHO_CPU)
+    {
+        task_start("ipc echo", DEFAULT_PRIORITY, 4096, ipc_echo_task, 0);
+    }
+    task_start("benchmark", DEFAULT_PRIORITY, 8192, bench_main, 0);
+    return;
+}
+
+PUBLIC void bench_ap_start(void)
+{
+    if (bench_enabled("ipc") && running_task()->cpu_id == BENCH_IPC_ECHO_CPU)
+    {
+        task_start("ipc echo", DEFAULT_PRIORITY, 4096, ipc_echo_task, 0);
+    }
+    return;
+}
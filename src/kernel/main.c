@@ -10,6 +10,7 @@
 #include <common.h>
 #include <intr.h>
 #include <io.h>
+#include <kernel/bench.h>
 #include <kernel/init.h>
 #include <kernel/syscall.h>
 #include <mem/page.h>
@@ -69,6 +70,7 @@ PRIVATE void ktask(void)
 PUBLIC void kernel_main(void)
 {
     init_all();
+    bench_start();
 
     message_t msg;
     while (1)
@@ -83,6 +85,7 @@ PUBLIC void kernel_main(void)
 PUBLIC void ap_kernel_main(void)
 {
     ap_init_all();
+    bench_ap_start();
     char name[31];
     sprintf(name, "k task %d", running_task()->cpu_id);
     proc_execute(name, DEFAULT_PRIORITY, 4096, ktask);
@@ -5,36 +5,55 @@
 
 #include <kernel/global.h>
 
+#include <intr.h> // intr_disable,intr_set_status
 #include <kernel/syscall.h>
 #include <mem/page.h> // allocate page
+#include <mem/shm.h>  // shm_region_create,shm_region_map
 #include <service.h>
 #include <std/string.h> // memcpy
-#include <task/task.h>  // pid_to_task
+#include <task/task.h>  // task_get,task_put
 
 // previous prototype for each function
 PUBLIC syscall_status_t kern_allocate_page(message_t *msg);
 PUBLIC syscall_status_t kern_free_page(message_t *msg);
 PUBLIC syscall_status_t kern_read_task_mem(message_t *msg);
+PUBLIC syscall_status_t kern_shm_create(message_t *msg);
+PUBLIC syscall_status_t kern_shm_grant(message_t *msg);
+PUBLIC syscall_status_t kern_shm_map(message_t *msg);
+PUBLIC syscall_status_t kern_shm_unmap(message_t *msg);
 
 PUBLIC syscall_status_t kern_allocate_page(message_t *msg)
 {
     uintptr_t *out_addr = (uintptr_t *)&msg->m[OUT_KERN_ALLOCATE_PAGE_ADDR];
 
-    task_struct_t *cur_task = running_task();
+    // 可能由环的轮询任务代为处理,不能使用running_task()
+    task_struct_t *task = task_get(msg->src);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
 
     status_t  status;
     uintptr_t vaddr = 0;
 
-    status = vmm_alloc(&cur_task->vmm_free, PG_SIZE, &vaddr);
-    if (ERROR(status))
+    // 只修改地址表,物理页在缺页时才分配
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&task->vmm_lock);
+    status = vmm_alloc(&task->vmm_free, PG_SIZE, &vaddr);
+    if (!ERROR(status))
     {
-        return SYSCALL_ERROR;
+        status = vmm_add_range(&task->vmm_using, vaddr, PG_SIZE);
+        if (ERROR(status))
+        {
+            vmm_add_range(&task->vmm_free, vaddr, PG_SIZE);
+        }
     }
+    spinlock_unlock(&task->vmm_lock);
+    intr_set_status(intr_status);
+    task_put(task);
 
-    status = vmm_add_range(&cur_task->vmm_using, vaddr, PG_SIZE);
     if (ERROR(status))
     {
-        vmm_add_range(&cur_task->vmm_free, vaddr, PG_SIZE);
         return SYSCALL_ERROR;
     }
     *out_addr = vaddr;
@@ -45,21 +64,42 @@ PUBLIC syscall_status_t kern_free_page(message_t *msg)
 {
     uintptr_t in_addr = (uintptr_t)msg->m[IN_KERN_FREE_PAGE_ADDR];
 
-    task_struct_t *cur_task = running_task();
-
-    uintptr_t vaddr;
-    void     *paddr;
-    vaddr = in_addr;
-    paddr = to_physical_address(cur_task->page_dir, (void *)vaddr);
+    // 没有跨cpu的TLB刷新,只能由任务自己在系统调用中释放,不可轮询
+    task_struct_t *task = task_get(msg->src);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
 
-    vmm_remove_range(&cur_task->vmm_using, vaddr, PG_SIZE);
-    vmm_add_range(&cur_task->vmm_free, vaddr, PG_SIZE);
+    uintptr_t vaddr = in_addr;
+    void     *paddr = NULL;
 
-    free_physical_page(paddr, 1);
-    page_unmap(cur_task->page_dir, (void *)vaddr);
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&task->vmm_lock);
+    // 共享内存区域需通过KERN_SHM_UNMAP解除映射
+    bool allocated = vmm_find(&task->vmm_using, vaddr);
+    if (allocated)
+    {
+        vmm_remove_range(&task->vmm_using, vaddr, PG_SIZE);
+        vmm_add_range(&task->vmm_free, vaddr, PG_SIZE);
+    }
+    spinlock_unlock(&task->vmm_lock);
+    intr_set_status(intr_status);
 
-    page_table_activate(cur_task);
-    return SYSCALL_SUCCESS;
+    // 页可能尚未被访问过,此时没有物理页
+    if (allocated)
+    {
+        paddr = to_physical_address(task->page_dir, (void *)vaddr);
+    }
+    if (paddr != NULL)
+    {
+        page_unmap(task->page_dir, (void *)vaddr);
+        // page_unmap已刷新当前cpu上的TLB项
+        page_table_changed(task);
+        free_physical_page(paddr, 1);
+    }
+    task_put(task);
+    return allocated ? SYSCALL_SUCCESS : SYSCALL_ERROR;
 }
 
 PUBLIC syscall_status_t kern_read_task_mem(message_t *msg)
@@ -75,10 +115,19 @@ PUBLIC syscall_status_t kern_read_task_mem(message_t *msg)
     size_t in_size   = (size_t)msg->m[IN_KERN_READ_TASK_MEM_SIZE];
     void  *in_buffer = (void *)msg->m[IN_KERN_READ_TASK_MEM_BUFFER];
 
-    task_struct_t *task = pid_to_task(in_pid);
-
-    in_addr = to_physical_address(task->page_dir, in_addr);
-    if (in_addr == NULL)
+    task_struct_t *task = task_get(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    // 任务退出时page_dir被设为NULL
+    void *page_dir = task->page_dir;
+    if (page_dir != NULL)
+    {
+        in_addr = to_physical_address(page_dir, in_addr);
+    }
+    task_put(task);
+    if (page_dir == NULL || in_addr == NULL)
     {
         return SYSCALL_ERROR;
     }
@@ -86,4 +135,67 @@ PUBLIC syscall_status_t kern_read_task_mem(message_t *msg)
 
     memcpy(in_buffer, in_addr, in_size);
     return SYSCALL_SUCCESS;
-}
\ No newline at end of file
+}
+
+PUBLIC syscall_status_t kern_shm_create(message_t *msg)
+{
+    size_t in_size = (size_t)msg->m[IN_KERN_SHM_CREATE_SIZE];
+
+    uint64_t  handle;
+    uintptr_t vaddr;
+    status_t  status;
+    status = shm_region_create(running_task(), in_size, &handle, &vaddr);
+    if (ERROR(status))
+    {
+        return SYSCALL_ERROR;
+    }
+    msg->m[OUT_KERN_SHM_CREATE_HANDLE] = handle;
+    msg->m[OUT_KERN_SHM_CREATE_ADDR]   = vaddr;
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_shm_grant(message_t *msg)
+{
+    uint64_t in_handle = msg->m[IN_KERN_SHM_GRANT_HANDLE];
+    pid_t    in_pid    = (pid_t)msg->m[IN_KERN_SHM_GRANT_PID];
+
+    if (!task_exist(in_pid))
+    {
+        return SYSCALL_DEST_NOT_EXIST;
+    }
+    status_t status = shm_region_grant(running_task(), in_handle, in_pid);
+    if (ERROR(status))
+    {
+        return SYSCALL_ERROR;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_shm_map(message_t *msg)
+{
+    uint64_t in_handle = msg->m[IN_KERN_SHM_MAP_HANDLE];
+
+    uintptr_t vaddr;
+    uint64_t  pages;
+    status_t  status;
+    status = shm_region_map(running_task(), in_handle, &vaddr, &pages);
+    if (ERROR(status))
+    {
+        return SYSCALL_ERROR;
+    }
+    msg->m[OUT_KERN_SHM_MAP_ADDR] = vaddr;
+    msg->m[OUT_KERN_SHM_MAP_SIZE] = pages * PG_SIZE;
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_shm_unmap(message_t *msg)
+{
+    uint64_t in_handle = msg->m[IN_KERN_SHM_UNMAP_HANDLE];
+
+    status_t status = shm_region_unmap(running_task(), in_handle);
+    if (ERROR(status))
+    {
+        return SYSCALL_ERROR;
+    }
+    return SYSCALL_SUCCESS;
+}
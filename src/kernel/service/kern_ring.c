@@ -0,0 +1,401 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/**
+ * Copyright (C) 2025 LinChenjun
+ */
+
+#include <kernel/global.h>
+
+#include <log.h>
+
+#include <device/spinlock.h> // spinlock
+#include <device/timer.h>    // get_current_ticks,MS_TO_TICKS
+#include <intr.h>            // intr_disable,intr_set_status
+#include <kernel/syscall.h>
+#include <mem/shm.h> // shm_region_get,shm_region_put
+#include <service.h>
+#include <std/string.h> // memcpy
+#include <task/task.h>  // running_task,task_start,task_block_locked
+
+// previous prototype for each function
+PUBLIC syscall_status_t kern_ring_setup(message_t *msg);
+PUBLIC syscall_status_t kern_ring_enter(message_t *msg);
+
+// 可同时存在的环的数量(每个进程最多一个)
+#define KERN_RINGS 16
+
+// 轮询任务每次最多处理一个环中的请求数,以免长时间持有kern_ring_lock
+#define RING_POLL_BATCH 32
+
+// 轮询任务在没有请求时继续轮询的时间(ms),之后休眠直到被唤醒
+#define RING_POLL_IDLE 2
+
+// 轮询时不断让出cpu,使用最低的普通优先级,只占用其他任务剩下的时间
+#define RING_POLL_PRIORITY NICE_TO_PRIO(MAX_NICE - 1)
+
+typedef struct kern_ring_s
+{
+    pid_t          pid;    // 所属的进程,PID_NO_TASK表示空闲
+    uint64_t       handle; // 存放环的共享内存区域
+    kernel_ring_t *ring;   // 环在内核中的地址
+    ring_sqe_t    *sqes;
+    ring_cqe_t    *cqes;
+    uint64_t       entries;
+
+    // 队列位置的内核副本,不读取任务可以修改的共享内存中的值
+    uint64_t sq_head;
+    uint64_t cq_tail;
+
+    bool poll;  // 由轮询任务处理
+    bool owner; // 由所属进程在KERN_RING_ENTER中处理,轮询任务跳过此环
+} kern_ring_t;
+
+PRIVATE kern_ring_t    kern_rings[KERN_RINGS];
+PRIVATE spinlock_t     kern_ring_lock;
+PRIVATE task_struct_t *ring_poller;
+PRIVATE bool           ring_poller_sleeping;
+
+/**
+ * @brief 查找进程的环
+ * @note 需持有kern_ring_lock
+ */
+PRIVATE kern_ring_t *ring_find(pid_t pid)
+{
+    int i;
+    for (i = 0; i < KERN_RINGS; i++)
+    {
+        if (kern_rings[i].pid == pid)
+        {
+            return &kern_rings[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 判断请求能否在环中处理
+ * @note 退出与环本身的操作不能放入环中
+ */
+PRIVATE bool ring_service_allowed(uint32_t type)
+{
+    return type != KERN_EXIT && type != KERN_RING_SETUP &&
+           type != KERN_RING_ENTER;
+}
+
+/**
+ * @brief 按顺序处理提交队列中的请求,将结果写入完成队列
+ * @param r 环
+ * @param limit 最多处理的请求数
+ * @param poller 是否由轮询任务处理
+ * @return 处理的请求数
+ * @note 提交队列为空或完成队列已满时停止.
+ *       轮询任务遇到不能代为处理的请求时停止,并交给所属进程处理
+ */
+PRIVATE uint64_t ring_process(kern_ring_t *r, uint64_t limit, bool poller)
+{
+    kernel_ring_t *ring = r->ring;
+    uint64_t       mask = r->entries - 1;
+    uint64_t       done = 0;
+    while (done < limit)
+    {
+        uint64_t sq_tail = atomic_read(&ring->sq_tail);
+        uint64_t cq_head = atomic_read(&ring->cq_head);
+        if (r->sq_head == sq_tail || r->cq_tail - cq_head >= r->entries)
+        {
+            break;
+        }
+        // 复制到内核中处理,任务同时修改提交项不会影响内核
+        ring_sqe_t *sqe       = &r->sqes[r->sq_head & mask];
+        uint64_t    user_data = sqe->user_data;
+        message_t   msg;
+        memcpy(&msg, &sqe->msg, sizeof(msg));
+
+        if (poller && !kernel_service_pollable(msg.type))
+        {
+            // 其后的请求也需等待所属进程按顺序处理
+            r->owner = TRUE;
+            atomic_bts(&ring->flags, RING_NEED_ENTER);
+            break;
+        }
+        syscall_status_t status = SYSCALL_ERROR;
+        if (ring_service_allowed(msg.type))
+        {
+            msg.src = r->pid;
+            status  = kernel_services(&msg);
+        }
+        ring_cqe_t *cqe = &r->cqes[r->cq_tail & mask];
+        cqe->user_data  = user_data;
+        cqe->status     = status;
+        memcpy(&cqe->msg, &msg, sizeof(msg));
+
+        // 完成项写入后才更新队列位置(atomic_set带有内存屏障)
+        r->sq_head++;
+        r->cq_tail++;
+        atomic_set(&ring->sq_head, r->sq_head);
+        atomic_set(&ring->cq_tail, r->cq_tail);
+        done++;
+    }
+    return done;
+}
+
+/**
+ * @brief 判断是否有轮询任务可以处理的请求
+ * @note 需持有kern_ring_lock
+ */
+PRIVATE bool ring_poll_pending(void)
+{
+    int i;
+    for (i = 0; i < KERN_RINGS; i++)
+    {
+        kern_ring_t *r = &kern_rings[i];
+        if (r->pid == PID_NO_TASK || !r->poll || r->owner)
+        {
+            continue;
+        }
+        if (r->sq_head != atomic_read(&r->ring->sq_tail))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * @brief 轮询任务休眠,直到被KERN_RING_ENTER唤醒
+ * @note 需持有kern_ring_lock,返回时已重新获取
+ */
+PRIVATE void ring_poll_sleep(void)
+{
+    int i;
+    for (i = 0; i < KERN_RINGS; i++)
+    {
+        if (kern_rings[i].pid != PID_NO_TASK && kern_rings[i].poll)
+        {
+            atomic_bts(&kern_rings[i].ring->flags, RING_NEED_WAKEUP);
+        }
+    }
+    // 设置标志(带有内存屏障)后再检查一次,
+    // 任务在看到标志之前提交的请求不会被遗漏
+    if (!ring_poll_pending())
+    {
+        ring_poller_sleeping = TRUE;
+        while (ring_poller_sleeping)
+        {
+            task_block_locked(TASK_BLOCKED, &kern_ring_lock);
+        }
+    }
+    for (i = 0; i < KERN_RINGS; i++)
+    {
+        if (kern_rings[i].pid != PID_NO_TASK && kern_rings[i].poll)
+        {
+            atomic_btr(&kern_rings[i].ring->flags, RING_NEED_WAKEUP);
+        }
+    }
+    return;
+}
+
+/**
+ * @brief 唤醒休眠的轮询任务
+ * @note 需持有kern_ring_lock,返回TRUE时需在释放锁后调用task_wakeup
+ */
+PRIVATE bool ring_poll_wake(void)
+{
+    if (!ring_poller_sleeping)
+    {
+        return FALSE;
+    }
+    ring_poller_sleeping = FALSE;
+    return TRUE;
+}
+
+PRIVATE void ring_poll_task(void)
+{
+    uint64_t      idle_start  = get_current_ticks();
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&kern_ring_lock);
+    while (1)
+    {
+        uint64_t done = 0;
+        int      i;
+        for (i = 0; i < KERN_RINGS; i++)
+        {
+            kern_ring_t *r = &kern_rings[i];
+            if (r->pid != PID_NO_TASK && r->poll && !r->owner)
+            {
+                done += ring_process(r, RING_POLL_BATCH, TRUE);
+            }
+        }
+        if (done > 0)
+        {
+            idle_start = get_current_ticks();
+        }
+        else if (get_current_ticks() - idle_start >=
+                 MS_TO_TICKS(RING_POLL_IDLE))
+        {
+            ring_poll_sleep();
+            idle_start = get_current_ticks();
+        }
+        // 让出cpu,提交请求的任务可以在同一个cpu上继续运行
+        spinlock_unlock(&kern_ring_lock);
+        intr_set_status(intr_status);
+        task_yield();
+        intr_status = intr_disable();
+        spinlock_lock(&kern_ring_lock);
+    }
+}
+
+PUBLIC void kern_ring_init(void)
+{
+    init_spinlock(&kern_ring_lock);
+    int i;
+    for (i = 0; i < KERN_RINGS; i++)
+    {
+        kern_rings[i].pid = PID_NO_TASK;
+    }
+    ring_poller_sleeping = FALSE;
+    ring_poller =
+        task_start("ring poll", RING_POLL_PRIORITY, 4096, ring_poll_task, 0);
+    PANIC(ring_poller == NULL, "Can not start ring poll task.\n");
+    return;
+}
+
+PUBLIC syscall_status_t kern_ring_setup(message_t *msg)
+{
+    uint64_t in_handle  = msg->m[IN_KERN_RING_SETUP_HANDLE];
+    uint64_t in_entries = msg->m[IN_KERN_RING_SETUP_ENTRIES];
+    uint64_t in_flags   = msg->m[IN_KERN_RING_SETUP_FLAGS];
+
+    if (in_entries == 0 || in_entries > RING_MAX_ENTRIES ||
+        (in_entries & (in_entries - 1)))
+    {
+        return SYSCALL_ERROR;
+    }
+    task_struct_t *cur_task = running_task();
+
+    void    *kaddr;
+    size_t   size;
+    status_t status;
+    status = shm_region_get(cur_task, in_handle, &kaddr, &size);
+    if (ERROR(status))
+    {
+        return SYSCALL_ERROR;
+    }
+    if (size < RING_SIZE(in_entries))
+    {
+        shm_region_put(in_handle);
+        return SYSCALL_ERROR;
+    }
+
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&kern_ring_lock);
+
+    kern_ring_t *r = NULL;
+    if (ring_find(cur_task->pid) == NULL)
+    {
+        r = ring_find(PID_NO_TASK);
+    }
+    if (r == NULL)
+    {
+        spinlock_unlock(&kern_ring_lock);
+        intr_set_status(intr_status);
+        shm_region_put(in_handle);
+        return SYSCALL_ERROR;
+    }
+    kernel_ring_t *ring = kaddr;
+    atomic_set(&ring->sq_head, 0);
+    atomic_set(&ring->cq_tail, 0);
+    atomic_set(&ring->flags, 0);
+    atomic_set(&ring->sq_tail, 0);
+    atomic_set(&ring->cq_head, 0);
+
+    r->handle  = in_handle;
+    r->ring    = ring;
+    r->sqes    = RING_SQES(ring);
+    r->cqes    = RING_CQES(ring, in_entries);
+    r->entries = in_entries;
+    r->sq_head = 0;
+    r->cq_tail = 0;
+    r->poll    = (in_flags & RING_SETUP_POLL) != 0;
+    r->owner   = FALSE;
+    if (r->poll && ring_poller_sleeping)
+    {
+        atomic_bts(&ring->flags, RING_NEED_WAKEUP);
+    }
+    r->pid = cur_task->pid;
+
+    spinlock_unlock(&kern_ring_lock);
+    intr_set_status(intr_status);
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_ring_enter(message_t *msg)
+{
+    uint64_t *out_done = &msg->m[OUT_KERN_RING_ENTER_DONE];
+
+    task_struct_t *cur_task = running_task();
+
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&kern_ring_lock);
+
+    kern_ring_t *r = ring_find(cur_task->pid);
+    if (r == NULL)
+    {
+        spinlock_unlock(&kern_ring_lock);
+        intr_set_status(intr_status);
+        return SYSCALL_ERROR;
+    }
+    // 轮询任务正在处理此环时只需唤醒它
+    bool process = !r->poll || r->owner;
+    spinlock_unlock(&kern_ring_lock);
+    intr_set_status(intr_status);
+
+    // 只有所属进程自身(退出时)会销毁环,处理时不需持有锁,
+    // 请求可以阻塞,也可以访问进程的用户内存
+    uint64_t done = 0;
+    if (process)
+    {
+        done = ring_process(r, r->entries, FALSE);
+    }
+
+    intr_status = intr_disable();
+    spinlock_lock(&kern_ring_lock);
+    bool wake = FALSE;
+    if (r->poll)
+    {
+        // 不是由此次调用处理时,轮询任务可能刚把环交给进程,保留RING_NEED_ENTER
+        if (process)
+        {
+            r->owner = FALSE;
+            atomic_btr(&r->ring->flags, RING_NEED_ENTER);
+        }
+        wake = ring_poll_wake();
+    }
+    spinlock_unlock(&kern_ring_lock);
+    intr_set_status(intr_status);
+    if (wake)
+    {
+        task_wakeup(ring_poller, TASK_BLOCKED);
+    }
+    *out_done = done;
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC void kern_ring_exit(pid_t pid)
+{
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&kern_ring_lock);
+    // 轮询任务处理时持有kern_ring_lock,此后不会再访问此环
+    kern_ring_t *r      = ring_find(pid);
+    uint64_t     handle = 0;
+    if (r != NULL)
+    {
+        r->pid = PID_NO_TASK;
+        handle = r->handle;
+    }
+    spinlock_unlock(&kern_ring_lock);
+    intr_set_status(intr_status);
+    if (r != NULL)
+    {
+        shm_region_put(handle);
+    }
+    return;
+}
@@ -0,0 +1,348 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/**
+ * Copyright (C) 2025 LinChenjun
+ */
+
+#include <kernel/global.h>
+
+#include <device/cpu.h> // NR_CPUS
+#include <kernel/syscall.h>
+#include <service.h>    // is_service_pid
+#include <std/string.h> // memcpy
+#include <task/task.h>  // get_task_man,task_get,task_set_*,task_group_*
+
+// previous prototype for each function
+PUBLIC syscall_status_t kern_get_fpu_stat(message_t *msg);
+PUBLIC syscall_status_t kern_get_task_time(message_t *msg);
+PUBLIC syscall_status_t kern_set_sched(message_t *msg);
+PUBLIC syscall_status_t kern_set_slice(message_t *msg);
+PUBLIC syscall_status_t kern_set_affinity(message_t *msg);
+PUBLIC syscall_status_t kern_get_affinity(message_t *msg);
+PUBLIC syscall_status_t kern_get_sched_avg(message_t *msg);
+PUBLIC syscall_status_t kern_create_group(message_t *msg);
+PUBLIC syscall_status_t kern_set_group_weight(message_t *msg);
+PUBLIC syscall_status_t kern_set_group(message_t *msg);
+PUBLIC syscall_status_t kern_get_group(message_t *msg);
+PUBLIC syscall_status_t kern_set_deadline(message_t *msg);
+PUBLIC syscall_status_t kern_get_task_stat(message_t *msg);
+PUBLIC syscall_status_t kern_get_cpu_stat(message_t *msg);
+
+STATIC_ASSERT(AFFINITY_MASK_WORDS == CPUMASK_WORDS, "");
+STATIC_ASSERT(TASK_DIED < SCHED_STAT_STATUSES, "");
+
+/**
+ * @brief 获取当前任务可以修改调度参数的任务(自身或子任务)
+ * @param pid 任务的pid
+ * @return 任务不存在,已退出或不能修改时返回NULL,否则需调用task_put
+ */
+PRIVATE task_struct_t *get_modifiable_task(pid_t pid)
+{
+    task_struct_t *task = task_get(pid);
+    if (task == NULL)
+    {
+        return NULL;
+    }
+    pid_t cur_pid = running_task()->pid;
+    if ((task->pid != cur_pid && task->ppid != cur_pid) ||
+        task->status == TASK_DIED)
+    {
+        task_put(task);
+        return NULL;
+    }
+    return task;
+}
+
+/**
+ * @brief 判断当前任务是否为内核任务或服务
+ * @note 只有它们能将任务提升为实时或截止期调度,
+ *       否则用户进程可以抢占TICK和键盘等服务,每秒占满实时带宽
+ */
+PRIVATE bool caller_is_privileged(void)
+{
+    task_struct_t *cur_task = running_task();
+    return cur_task->page_dir == NULL || is_service_pid(cur_task->pid);
+}
+
+/**
+ * @brief 获取检查任务组属主时使用的调用者
+ * @return 内核任务与服务返回PID_NO_TASK(不受限制),否则返回当前任务的pid
+ */
+PRIVATE pid_t group_caller(void)
+{
+    return caller_is_privileged() ? PID_NO_TASK : running_task()->pid;
+}
+
+PUBLIC syscall_status_t kern_get_fpu_stat(message_t *msg)
+{
+    uint32_t in_cpu = (uint32_t)msg->m[IN_KERN_GET_FPU_STAT_CPU];
+
+    if (in_cpu >= NR_CPUS)
+    {
+        return SYSCALL_ERROR;
+    }
+    task_man_t *task_man = get_task_man(in_cpu);
+    if (task_man->main_task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    msg->m[OUT_KERN_GET_FPU_STAT_SWITCHES] = task_man->fpu_switches;
+    msg->m[OUT_KERN_GET_FPU_STAT_SAVES]    = task_man->fpu_saves;
+    msg->m[OUT_KERN_GET_FPU_STAT_RESTORES] = task_man->fpu_restores;
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_get_task_time(message_t *msg)
+{
+    pid_t in_pid = (pid_t)msg->m[IN_KERN_GET_TASK_TIME_PID];
+
+    task_struct_t *task = task_get(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+
+    msg->m[OUT_KERN_GET_TASK_TIME_USER]   = task->user_time;
+    msg->m[OUT_KERN_GET_TASK_TIME_KERNEL] = task->kernel_time;
+    msg->m[OUT_KERN_GET_TASK_TIME_WAIT]   = task->wait_time;
+    task_put(task);
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_set_sched(message_t *msg)
+{
+    pid_t    in_pid         = (pid_t)msg->m[IN_KERN_SET_SCHED_PID];
+    uint32_t in_policy      = (uint32_t)msg->m[IN_KERN_SET_SCHED_POLICY];
+    uint32_t in_rt_priority = (uint32_t)msg->m[IN_KERN_SET_SCHED_RT_PRIORITY];
+
+    if (in_policy != SCHED_NORMAL && !caller_is_privileged())
+    {
+        return SYSCALL_ERROR;
+    }
+    // 只能修改自身或子任务的调度策略
+    task_struct_t *task = get_modifiable_task(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    status_t status = task_set_scheduler(task, in_policy, in_rt_priority);
+    task_put(task);
+    if (ERROR(status))
+    {
+        return SYSCALL_ERROR;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_set_slice(message_t *msg)
+{
+    pid_t    in_pid   = (pid_t)msg->m[IN_KERN_SET_SLICE_PID];
+    uint64_t in_slice = msg->m[IN_KERN_SET_SLICE_SLICE];
+
+    task_struct_t *task = get_modifiable_task(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    status_t status = task_set_slice(task, in_slice);
+    task_put(task);
+    if (ERROR(status))
+    {
+        return SYSCALL_ERROR;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_set_affinity(message_t *msg)
+{
+    pid_t     in_pid  = (pid_t)msg->m[IN_KERN_SET_AFFINITY_PID];
+    uint64_t *in_mask = &msg->m[IN_KERN_SET_AFFINITY_MASK];
+
+    task_struct_t *task = get_modifiable_task(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    cpumask_t mask;
+    int       i;
+    for (i = 0; i < CPUMASK_WORDS; i++)
+    {
+        mask.bits[i] = in_mask[i];
+    }
+    status_t status = task_set_affinity(task, &mask);
+    task_put(task);
+    if (ERROR(status))
+    {
+        return SYSCALL_ERROR;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_get_affinity(message_t *msg)
+{
+    pid_t in_pid = (pid_t)msg->m[IN_KERN_GET_AFFINITY_PID];
+
+    task_struct_t *task = task_get(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    int i;
+    for (i = 0; i < CPUMASK_WORDS; i++)
+    {
+        msg->m[OUT_KERN_GET_AFFINITY_MASK + i] = task->cpus_allowed.bits[i];
+    }
+    task_put(task);
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_get_sched_avg(message_t *msg)
+{
+    pid_t in_pid = (pid_t)msg->m[IN_KERN_GET_SCHED_AVG_PID];
+
+    task_struct_t *task = task_get(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    sched_avg_t task_avg;
+    sched_avg_t cpu_avg;
+    uint32_t    cpu = task_get_sched_avg(task, &task_avg, &cpu_avg);
+    task_put(task);
+
+    msg->m[OUT_KERN_GET_SCHED_AVG_LOAD]         = task_avg.load_avg;
+    msg->m[OUT_KERN_GET_SCHED_AVG_RUNNABLE]     = task_avg.runnable_avg;
+    msg->m[OUT_KERN_GET_SCHED_AVG_UTIL]         = task_avg.util_avg;
+    msg->m[OUT_KERN_GET_SCHED_AVG_CPU]          = cpu;
+    msg->m[OUT_KERN_GET_SCHED_AVG_CPU_LOAD]     = cpu_avg.load_avg;
+    msg->m[OUT_KERN_GET_SCHED_AVG_CPU_RUNNABLE] = cpu_avg.runnable_avg;
+    msg->m[OUT_KERN_GET_SCHED_AVG_CPU_UTIL]     = cpu_avg.util_avg;
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_create_group(message_t *msg)
+{
+    uint64_t in_weight = msg->m[IN_KERN_CREATE_GROUP_WEIGHT];
+
+    // 任务组中的任务不能创建任务组
+    task_struct_t *cur_task = running_task();
+    if (task_get_group(cur_task) != 0 && !caller_is_privileged())
+    {
+        return SYSCALL_ERROR;
+    }
+    uint32_t id;
+    if (ERROR(task_group_create(in_weight, cur_task->pid, &id)))
+    {
+        return SYSCALL_ERROR;
+    }
+    msg->m[OUT_KERN_CREATE_GROUP_ID] = id;
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_set_group_weight(message_t *msg)
+{
+    uint32_t in_id     = (uint32_t)msg->m[IN_KERN_SET_GROUP_WEIGHT_ID];
+    uint64_t in_weight = msg->m[IN_KERN_SET_GROUP_WEIGHT_WEIGHT];
+
+    if (ERROR(task_group_set_weight(in_id, in_weight, group_caller())))
+    {
+        return SYSCALL_ERROR;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_set_group(message_t *msg)
+{
+    pid_t    in_pid = (pid_t)msg->m[IN_KERN_SET_GROUP_PID];
+    uint32_t in_id  = (uint32_t)msg->m[IN_KERN_SET_GROUP_ID];
+
+    task_struct_t *task = get_modifiable_task(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    status_t status = task_set_group(task, in_id, group_caller());
+    task_put(task);
+    if (ERROR(status))
+    {
+        return SYSCALL_ERROR;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_get_group(message_t *msg)
+{
+    pid_t in_pid = (pid_t)msg->m[IN_KERN_GET_GROUP_PID];
+
+    task_struct_t *task = task_get(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    msg->m[OUT_KERN_GET_GROUP_ID] = task_get_group(task);
+    task_put(task);
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_set_deadline(message_t *msg)
+{
+    pid_t    in_pid      = (pid_t)msg->m[IN_KERN_SET_DEADLINE_PID];
+    uint64_t in_runtime  = msg->m[IN_KERN_SET_DEADLINE_RUNTIME];
+    uint64_t in_deadline = msg->m[IN_KERN_SET_DEADLINE_DEADLINE];
+    uint64_t in_period   = msg->m[IN_KERN_SET_DEADLINE_PERIOD];
+
+    if (!caller_is_privileged())
+    {
+        return SYSCALL_ERROR;
+    }
+    task_struct_t *task = get_modifiable_task(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    status_t status;
+    status = task_set_deadline(task, in_runtime, in_deadline, in_period);
+    task_put(task);
+    if (ERROR(status))
+    {
+        return SYSCALL_ERROR;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_get_task_stat(message_t *msg)
+{
+    pid_t in_pid    = (pid_t)msg->m[IN_KERN_GET_TASK_STAT_PID];
+    void *in_buffer = (void *)msg->m[IN_KERN_GET_TASK_STAT_BUFFER];
+
+    if (in_buffer == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    task_struct_t *task = task_get(in_pid);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    // 统计由任务所在的cpu更新,此处不加锁读取,各项之间可能不完全一致
+    memcpy(in_buffer, &task->sched_stat, sizeof(task->sched_stat));
+    task_put(task);
+    return SYSCALL_SUCCESS;
+}
+
+PUBLIC syscall_status_t kern_get_cpu_stat(message_t *msg)
+{
+    uint32_t in_cpu    = (uint32_t)msg->m[IN_KERN_GET_CPU_STAT_CPU];
+    void    *in_buffer = (void *)msg->m[IN_KERN_GET_CPU_STAT_BUFFER];
+
+    if (in_cpu >= NR_CPUS || in_buffer == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    task_man_t *task_man = get_task_man(in_cpu);
+    if (task_man->main_task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    memcpy(in_buffer, &task_man->sched_stat, sizeof(task_man->sched_stat));
+    return SYSCALL_SUCCESS;
+}
@@ -7,10 +7,11 @@
 
 #include <log.h>
 
+#include <intr.h> // intr_disable,intr_set_status
 #include <kernel/syscall.h>
 #include <service.h>
 #include <std/string.h> // memcpy
-#include <task/task.h>  // running_task
+#include <task/task.h>  // running_task,task_get
 
 // previous prototype for each function
 PUBLIC syscall_status_t kern_exit(message_t *msg);
@@ -34,9 +35,8 @@ PUBLIC syscall_status_t kern_get_pid(message_t *msg)
 {
     pid_t *out_pid = (pid_t *)&msg->m[OUT_KERN_GET_PID_PID];
 
-    task_struct_t *task = running_task();
-
-    *out_pid = task->pid; // or msg->src
+    // 可能由环的轮询任务代为处理,不能使用running_task()
+    *out_pid = msg->src;
 
     return SYSCALL_SUCCESS;
 }
@@ -45,9 +45,13 @@ PUBLIC syscall_status_t kern_get_ppid(message_t *msg)
 {
     pid_t *out_ppid = (pid_t *)&msg->m[OUT_KERN_GET_PPID_PPID];
 
-    task_struct_t *task = running_task();
-
+    task_struct_t *task = task_get(msg->src);
+    if (task == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
     *out_ppid = task->ppid;
+    task_put(task);
 
     return SYSCALL_SUCCESS;
 }
@@ -105,11 +109,15 @@ PUBLIC syscall_status_t kern_waitpid(message_t *msg)
 
         return K_ERROR;
     }
-    // 用while防止意外唤醒(但是这种情况不应该发生)
-    while (!task_has_exited_child(task->pid))
+    // 子任务退出时由inform_exit唤醒,用while防止意外唤醒
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&task->child_list_lock);
+    while (list_empty(&task->exited_child_list))
     {
-        task_block(TASK_WAITING);
+        task_block_locked(TASK_WAITING, &task->child_list_lock);
     }
+    spinlock_unlock(&task->child_list_lock);
+    intr_set_status(intr_status);
 
     task_struct_t *child;
     list_node_t   *child_node;
@@ -126,6 +134,11 @@ PUBLIC syscall_status_t kern_waitpid(message_t *msg)
         spinlock_lock(&task->child_list_lock);
         child_node =
             list_traversal(&task->exited_child_list, find_child, task->pid);
+        if (child_node != NULL)
+        {
+            // 回收后general_tag用于task_put中的空闲列表
+            list_remove(child_node);
+        }
         spinlock_unlock(&task->child_list_lock);
         if (child_node == NULL)
         {
@@ -23,10 +23,54 @@ PUBLIC syscall_status_t kern_waitpid(message_t *msg);
 PUBLIC syscall_status_t kern_allocate_page(message_t *msg);
 PUBLIC syscall_status_t kern_free_page(message_t *msg);
 PUBLIC syscall_status_t kern_read_task_mem(message_t *msg);
+PUBLIC syscall_status_t kern_shm_create(message_t *msg);
+PUBLIC syscall_status_t kern_shm_grant(message_t *msg);
+PUBLIC syscall_status_t kern_shm_map(message_t *msg);
+PUBLIC syscall_status_t kern_shm_unmap(message_t *msg);
+
+// kern_sched.c
+PUBLIC syscall_status_t kern_get_fpu_stat(message_t *msg);
+PUBLIC syscall_status_t kern_get_task_time(message_t *msg);
+PUBLIC syscall_status_t kern_set_sched(message_t *msg);
+PUBLIC syscall_status_t kern_set_slice(message_t *msg);
+PUBLIC syscall_status_t kern_set_affinity(message_t *msg);
+PUBLIC syscall_status_t kern_get_affinity(message_t *msg);
+PUBLIC syscall_status_t kern_get_sched_avg(message_t *msg);
+PUBLIC syscall_status_t kern_create_group(message_t *msg);
+PUBLIC syscall_status_t kern_set_group_weight(message_t *msg);
+PUBLIC syscall_status_t kern_set_group(message_t *msg);
+PUBLIC syscall_status_t kern_get_group(message_t *msg);
+PUBLIC syscall_status_t kern_set_deadline(message_t *msg);
+PUBLIC syscall_status_t kern_get_task_stat(message_t *msg);
+PUBLIC syscall_status_t kern_get_cpu_stat(message_t *msg);
+
+// kern_ring.c
+PUBLIC syscall_status_t kern_ring_setup(message_t *msg);
+PUBLIC syscall_status_t kern_ring_enter(message_t *msg);
 
 PRIVATE kern_syscall_t kern_syscalls[KERN_SYSCALLS] = {
-    kern_exit,    kern_get_pid,       kern_get_ppid,  kern_create_proc,
-    kern_waitpid, kern_allocate_page, kern_free_page, kern_read_task_mem,
+    kern_exit,          kern_get_pid,          kern_get_ppid,
+    kern_create_proc,   kern_waitpid,          kern_allocate_page,
+    kern_free_page,     kern_read_task_mem,    kern_get_fpu_stat,
+    kern_get_task_time, kern_set_sched,        kern_set_slice,
+    kern_set_affinity,  kern_get_affinity,     kern_get_sched_avg,
+    kern_create_group,  kern_set_group_weight, kern_set_group,
+    kern_get_group,     kern_set_deadline,     kern_get_task_stat,
+    kern_get_cpu_stat,  kern_shm_create,       kern_shm_grant,
+    kern_shm_map,       kern_shm_unmap,        kern_ring_setup,
+    kern_ring_enter,
+};
+
+// 以msg->src识别调用者,不依赖当前任务,可由环的轮询任务处理的内核服务
+PRIVATE bool kern_syscalls_pollable[KERN_SYSCALLS] = {
+    [KERN_GET_PID]       = TRUE,
+    [KERN_GET_PPID]      = TRUE,
+    [KERN_ALLOCATE_PAGE] = TRUE,
+    [KERN_GET_FPU_STAT]  = TRUE,
+    [KERN_GET_TASK_TIME] = TRUE,
+    [KERN_GET_AFFINITY]  = TRUE,
+    [KERN_GET_SCHED_AVG] = TRUE,
+    [KERN_GET_GROUP]     = TRUE,
 };
 
 PUBLIC syscall_status_t kernel_services(message_t *msg)
@@ -41,3 +85,8 @@ PUBLIC syscall_status_t kernel_services(message_t *msg)
     }
     return ret;
 }
+
+PUBLIC bool kernel_service_pollable(uint32_t type)
+{
+    return type < KERN_SYSCALLS && kern_syscalls_pollable[type];
+}
@@ -0,0 +1,384 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/**
+ * Copyright (C) 2024-2025 LinChenjun
+ */
+
+#include <kernel/global.h>
+
+#include <lib/rbtree.h>
+
+PUBLIC void init_rbtree(rbtree_t *tree)
+{
+    tree->root     = NULL;
+    tree->leftmost = NULL;
+    tree->augment  = NULL;
+    return;
+}
+
+PUBLIC void
+init_rbtree_augmented(rbtree_t *tree, void (*augment)(rbtree_node_t *node))
+{
+    init_rbtree(tree);
+    tree->augment = augment;
+    return;
+}
+
+/**
+ * @brief 从node开始向上更新到根节点的子树信息
+ */
+PRIVATE void augment_propagate(rbtree_t *tree, rbtree_node_t *node)
+{
+    if (tree->augment == NULL)
+    {
+        return;
+    }
+    while (node != NULL)
+    {
+        tree->augment(node);
+        node = node->parent;
+    }
+    return;
+}
+
+/**
+ * @brief 旋转后更新两个发生变化的节点(先更新下方的节点)
+ */
+PRIVATE void
+augment_rotate(rbtree_t *tree, rbtree_node_t *lower, rbtree_node_t *upper)
+{
+    if (tree->augment == NULL)
+    {
+        return;
+    }
+    tree->augment(lower);
+    tree->augment(upper);
+    return;
+}
+
+PRIVATE bool is_black(rbtree_node_t *node)
+{
+    return node == NULL || node->color == RBTREE_BLACK;
+}
+
+/**
+ * @brief 用new_node替换old_node在其父节点中的位置
+ */
+PRIVATE void replace_child(
+    rbtree_t      *tree,
+    rbtree_node_t *parent,
+    rbtree_node_t *old_node,
+    rbtree_node_t *new_node
+)
+{
+    if (parent == NULL)
+    {
+        tree->root = new_node;
+    }
+    else if (parent->left == old_node)
+    {
+        parent->left = new_node;
+    }
+    else
+    {
+        parent->right = new_node;
+    }
+    return;
+}
+
+PRIVATE void rotate_left(rbtree_t *tree, rbtree_node_t *node)
+{
+    rbtree_node_t *right = node->right;
+
+    node->right = right->left;
+    if (right->left != NULL)
+    {
+        right->left->parent = node;
+    }
+    right->parent = node->parent;
+    replace_child(tree, node->parent, node, right);
+    right->left  = node;
+    node->parent = right;
+    augment_rotate(tree, node, right);
+    return;
+}
+
+PRIVATE void rotate_right(rbtree_t *tree, rbtree_node_t *node)
+{
+    rbtree_node_t *left = node->left;
+
+    node->left = left->right;
+    if (left->right != NULL)
+    {
+        left->right->parent = node;
+    }
+    left->parent = node->parent;
+    replace_child(tree, node->parent, node, left);
+    left->right  = node;
+    node->parent = left;
+    augment_rotate(tree, node, left);
+    return;
+}
+
+PRIVATE void insert_fixup(rbtree_t *tree, rbtree_node_t *node)
+{
+    rbtree_node_t *parent, *gparent, *uncle;
+    while ((parent = node->parent) != NULL && parent->color == RBTREE_RED)
+    {
+        gparent = parent->parent;
+        if (parent == gparent->left)
+        {
+            uncle = gparent->right;
+            if (!is_black(uncle))
+            {
+                parent->color  = RBTREE_BLACK;
+                uncle->color   = RBTREE_BLACK;
+                gparent->color = RBTREE_RED;
+                node           = gparent;
+                continue;
+            }
+            if (node == parent->right)
+            {
+                rotate_left(tree, parent);
+                node   = parent;
+                parent = node->parent;
+            }
+            parent->color  = RBTREE_BLACK;
+            gparent->color = RBTREE_RED;
+            rotate_right(tree, gparent);
+        }
+        else
+        {
+            uncle = gparent->left;
+            if (!is_black(uncle))
+            {
+                parent->color  = RBTREE_BLACK;
+                uncle->color   = RBTREE_BLACK;
+                gparent->color = RBTREE_RED;
+                node           = gparent;
+                continue;
+            }
+            if (node == parent->left)
+            {
+                rotate_right(tree, parent);
+                node   = parent;
+                parent = node->parent;
+            }
+            parent->color  = RBTREE_BLACK;
+            gparent->color = RBTREE_RED;
+            rotate_left(tree, gparent);
+        }
+    }
+    tree->root->color = RBTREE_BLACK;
+    return;
+}
+
+PUBLIC void rbtree_insert(
+    rbtree_t      *tree,
+    rbtree_node_t *node,
+    bool (*less)(rbtree_node_t *a, rbtree_node_t *b)
+)
+{
+    rbtree_node_t **link     = &tree->root;
+    rbtree_node_t  *parent   = NULL;
+    bool            leftmost = TRUE;
+
+    while (*link != NULL)
+    {
+        parent = *link;
+        if (less(node, parent))
+        {
+            link = &parent->left;
+        }
+        else
+        {
+            link     = &parent->right;
+            leftmost = FALSE;
+        }
+    }
+    node->parent = parent;
+    node->left   = NULL;
+    node->right  = NULL;
+    node->color  = RBTREE_RED;
+    *link        = node;
+    if (leftmost)
+    {
+        tree->leftmost = node;
+    }
+    augment_propagate(tree, node);
+    insert_fixup(tree, node);
+    return;
+}
+
+/**
+ * @brief 删除黑色节点后恢复红黑树的性质
+ * @param node 顶替被删除节点位置的节点(可能为NULL)
+ * @param parent node的父节点
+ */
+PRIVATE void
+remove_fixup(rbtree_t *tree, rbtree_node_t *node, rbtree_node_t *parent)
+{
+    rbtree_node_t *other;
+    while (is_black(node) && node != tree->root)
+    {
+        if (parent->left == node)
+        {
+            other = parent->right;
+            if (other->color == RBTREE_RED)
+            {
+                other->color  = RBTREE_BLACK;
+                parent->color = RBTREE_RED;
+                rotate_left(tree, parent);
+                other = parent->right;
+            }
+            if (is_black(other->left) && is_black(other->right))
+            {
+                other->color = RBTREE_RED;
+                node         = parent;
+                parent       = node->parent;
+                continue;
+            }
+            if (is_black(other->right))
+            {
+                other->left->color = RBTREE_BLACK;
+                other->color       = RBTREE_RED;
+                rotate_right(tree, other);
+                other = parent->right;
+            }
+            other->color        = parent->color;
+            parent->color       = RBTREE_BLACK;
+            other->right->color = RBTREE_BLACK;
+            rotate_left(tree, parent);
+        }
+        else
+        {
+            other = parent->left;
+            if (other->color == RBTREE_RED)
+            {
+                other->color  = RBTREE_BLACK;
+                parent->color = RBTREE_RED;
+                rotate_right(tree, parent);
+                other = parent->left;
+            }
+            if (is_black(other->left) && is_black(other->right))
+            {
+                other->color = RBTREE_RED;
+                node         = parent;
+                parent       = node->parent;
+                continue;
+            }
+            if (is_black(other->left))
+            {
+                other->right->color = RBTREE_BLACK;
+                other->color        = RBTREE_RED;
+                rotate_left(tree, other);
+                other = parent->left;
+            }
+            other->color       = parent->color;
+            parent->color      = RBTREE_BLACK;
+            other->left->color = RBTREE_BLACK;
+            rotate_right(tree, parent);
+        }
+        node = tree->root;
+        break;
+    }
+    if (node != NULL)
+    {
+        node->color = RBTREE_BLACK;
+    }
+    return;
+}
+
+PUBLIC void rbtree_remove(rbtree_t *tree, rbtree_node_t *node)
+{
+    rbtree_node_t *child, *parent;
+    int            color;
+
+    if (tree->leftmost == node)
+    {
+        tree->leftmost = rbtree_next(node);
+    }
+
+    if (node->left != NULL && node->right != NULL)
+    {
+        // 有两个子节点,用后继节点顶替node的位置
+        rbtree_node_t *old = node;
+
+        node = old->right;
+        while (node->left != NULL)
+        {
+            node = node->left;
+        }
+        replace_child(tree, old->parent, old, node);
+
+        child  = node->right;
+        parent = node->parent;
+        color  = node->color;
+
+        if (parent == old)
+        {
+            parent = node;
+        }
+        else
+        {
+            if (child != NULL)
+            {
+                child->parent = parent;
+            }
+            parent->left       = child;
+            node->right        = old->right;
+            old->right->parent = node;
+        }
+        node->parent      = old->parent;
+        node->color       = old->color;
+        node->left        = old->left;
+        old->left->parent = node;
+    }
+    else
+    {
+        child  = node->left != NULL ? node->left : node->right;
+        parent = node->parent;
+        color  = node->color;
+        if (child != NULL)
+        {
+            child->parent = parent;
+        }
+        replace_child(tree, parent, node, child);
+    }
+    // parent以上的节点的子树都发生了变化
+    augment_propagate(tree, parent);
+
+    if (color == RBTREE_BLACK)
+    {
+        remove_fixup(tree, child, parent);
+    }
+    return;
+}
+
+PUBLIC rbtree_node_t *rbtree_first(rbtree_t *tree)
+{
+    return tree->leftmost;
+}
+
+PUBLIC rbtree_node_t *rbtree_next(rbtree_node_t *node)
+{
+    rbtree_node_t *parent;
+    if (node->right != NULL)
+    {
+        node = node->right;
+        while (node->left != NULL)
+        {
+            node = node->left;
+        }
+        return node;
+    }
+    while ((parent = node->parent) != NULL && node == parent->right)
+    {
+        node = parent;
+    }
+    return parent;
+}
+
+PUBLIC bool rbtree_empty(rbtree_t *tree)
+{
+    return tree->root == NULL;
+}
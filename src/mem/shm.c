@@ -0,0 +1,400 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/**
+ * Copyright (C) 2025 LinChenjun
+ */
+
+#include <kernel/global.h>
+
+#include <log.h>
+
+#include <device/spinlock.h> // spinlock
+#include <intr.h>            // intr_disable,intr_set_status
+#include <mem/page.h>        // alloc_physical_page,page_map,PHYS_TO_VIRT
+#include <mem/shm.h>         // previous prototype
+#include <mem/vmm.h>         // vmm_alloc,vmm_add_range
+#include <task/task.h>       // page_table_changed,task_get
+
+typedef struct shm_map_s
+{
+    pid_t     pid;   // 被授权的任务,PID_NO_TASK表示空闲
+    uintptr_t vaddr; // 区域在任务中的地址,0表示尚未映射
+} shm_map_t;
+
+typedef struct shm_region_s
+{
+    uint64_t  gen;    // 区域被释放后递增,使旧的句柄失效
+    uint64_t  pages;  // 页数,0表示区域空闲
+    uintptr_t paddr;  // 区域的物理地址(连续的物理页)
+    pid_t     owner;  // 创建者,PID_NO_TASK表示创建者已解除映射或退出
+    uint64_t  mapped; // 映射与内核引用的数量,为0时释放区域
+    shm_map_t maps[SHM_MAPS];
+} shm_region_t;
+
+PRIVATE shm_region_t shm_regions[SHM_REGIONS];
+PRIVATE spinlock_t   shm_lock;
+
+PUBLIC void shm_init(void)
+{
+    init_spinlock(&shm_lock);
+    int i;
+    for (i = 0; i < SHM_REGIONS; i++)
+    {
+        shm_regions[i].gen   = 1;
+        shm_regions[i].pages = 0;
+    }
+    return;
+}
+
+/**
+ * @brief 根据句柄查找正在使用的区域
+ * @note 需持有shm_lock
+ */
+PRIVATE shm_region_t *shm_lookup(uint64_t handle)
+{
+    shm_region_t *region = &shm_regions[handle % SHM_REGIONS];
+    if (region->pages == 0 || region->gen != handle / SHM_REGIONS)
+    {
+        return NULL;
+    }
+    return region;
+}
+
+/**
+ * @brief 查找pid在区域中的授权
+ * @note 需持有shm_lock
+ */
+PRIVATE shm_map_t *shm_find_map(shm_region_t *region, pid_t pid)
+{
+    int i;
+    for (i = 0; i < SHM_MAPS; i++)
+    {
+        if (region->maps[i].pid == pid)
+        {
+            return &region->maps[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 将区域映射到当前任务的地址空间中
+ * @note 需持有shm_lock
+ */
+PRIVATE status_t
+shm_map_task(shm_region_t *region, shm_map_t *map, task_struct_t *task)
+{
+    if (task->page_dir == NULL)
+    {
+        return K_NOSUPPORT;
+    }
+    size_t    size  = region->pages * PG_SIZE;
+    uintptr_t vaddr = 0;
+
+    spinlock_lock(&task->vmm_lock);
+    status_t status = vmm_alloc(&task->vmm_free, size, &vaddr);
+    spinlock_unlock(&task->vmm_lock);
+    if (ERROR(status))
+    {
+        return status;
+    }
+    // 共享的页不加入vmm_using,不会在缺页时分配,也不能用free_page释放
+    uint64_t i;
+    for (i = 0; i < region->pages; i++)
+    {
+        page_map(
+            task->page_dir,
+            (void *)(region->paddr + i * PG_SIZE),
+            (void *)(vaddr + i * PG_SIZE)
+        );
+    }
+    map->vaddr = vaddr;
+    region->mapped++;
+    return K_SUCCESS;
+}
+
+/**
+ * @brief 减少区域的映射数量,为0时释放区域
+ * @note 需持有shm_lock
+ */
+PRIVATE void shm_region_release(shm_region_t *region)
+{
+    region->mapped--;
+    if (region->mapped > 0)
+    {
+        return;
+    }
+    free_physical_page((void *)region->paddr, region->pages);
+    region->pages = 0;
+    region->gen++;
+    return;
+}
+
+/**
+ * @brief 解除当前任务对区域的映射,最后一个映射被解除时释放区域
+ * @note 需持有shm_lock
+ */
+PRIVATE void
+shm_unmap_task(shm_region_t *region, shm_map_t *map, task_struct_t *task)
+{
+    size_t   size = region->pages * PG_SIZE;
+    uint64_t i;
+    for (i = 0; i < region->pages; i++)
+    {
+        page_unmap(task->page_dir, (void *)(map->vaddr + i * PG_SIZE));
+    }
+    page_table_changed(task);
+    spinlock_lock(&task->vmm_lock);
+    vmm_add_range(&task->vmm_free, map->vaddr, size);
+    spinlock_unlock(&task->vmm_lock);
+    map->vaddr = 0;
+    shm_region_release(region);
+    return;
+}
+
+PUBLIC status_t shm_region_create(
+    task_struct_t *task,
+    size_t         size,
+    uint64_t      *handle,
+    uintptr_t     *vaddr
+)
+{
+    uint64_t pages = DIV_ROUND_UP(size, PG_SIZE);
+    if (pages == 0 || pages > SHM_MAX_PAGES)
+    {
+        return K_INVALID_PARAM;
+    }
+    uintptr_t paddr;
+    status_t  status = alloc_physical_page(pages, &paddr);
+    if (ERROR(status))
+    {
+        return status;
+    }
+
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&shm_lock);
+
+    shm_region_t *region = NULL;
+    int           i;
+    for (i = 0; i < SHM_REGIONS; i++)
+    {
+        if (shm_regions[i].pages == 0)
+        {
+            region = &shm_regions[i];
+            break;
+        }
+    }
+    if (region == NULL)
+    {
+        spinlock_unlock(&shm_lock);
+        intr_set_status(intr_status);
+        free_physical_page((void *)paddr, pages);
+        return K_OUT_OF_RESOURCE;
+    }
+    region->pages  = pages;
+    region->paddr  = paddr;
+    region->owner  = task->pid;
+    region->mapped = 0;
+    for (i = 0; i < SHM_MAPS; i++)
+    {
+        region->maps[i].pid   = PID_NO_TASK;
+        region->maps[i].vaddr = 0;
+    }
+    region->maps[0].pid = task->pid;
+
+    status = shm_map_task(region, &region->maps[0], task);
+    if (ERROR(status))
+    {
+        free_physical_page((void *)paddr, pages);
+        region->pages = 0;
+        region->gen++;
+    }
+    else
+    {
+        *handle = region->gen * SHM_REGIONS + (region - shm_regions);
+        *vaddr  = region->maps[0].vaddr;
+    }
+    spinlock_unlock(&shm_lock);
+    intr_set_status(intr_status);
+    return status;
+}
+
+PUBLIC status_t
+shm_region_grant(task_struct_t *task, uint64_t handle, pid_t pid)
+{
+    status_t      status      = K_SUCCESS;
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&shm_lock);
+
+    // 内核任务退出时不会撤销授权,pid被重新分配后新的任务可以映射此区域
+    task_struct_t *target = task_get(pid);
+    shm_region_t  *region = shm_lookup(handle);
+    if (region == NULL || region->owner != task->pid || target == NULL ||
+        target->page_dir == NULL)
+    {
+        status = K_INVALID_PARAM;
+    }
+    else if (shm_find_map(region, pid) == NULL)
+    {
+        shm_map_t *map = shm_find_map(region, PID_NO_TASK);
+        if (map == NULL)
+        {
+            status = K_OUT_OF_RESOURCE;
+        }
+        else
+        {
+            map->pid = pid;
+        }
+    }
+    spinlock_unlock(&shm_lock);
+    intr_set_status(intr_status);
+    if (target != NULL)
+    {
+        task_put(target);
+    }
+    return status;
+}
+
+PUBLIC status_t shm_region_map(
+    task_struct_t *task,
+    uint64_t       handle,
+    uintptr_t     *vaddr,
+    uint64_t      *pages
+)
+{
+    status_t      status      = K_SUCCESS;
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&shm_lock);
+
+    shm_region_t *region = shm_lookup(handle);
+    shm_map_t    *map    = NULL;
+    if (region != NULL)
+    {
+        map = shm_find_map(region, task->pid);
+    }
+    // 创建者不再使用的区域不能再被映射,其他任务据此解除映射
+    if (map == NULL || region->owner == PID_NO_TASK)
+    {
+        status = K_INVALID_PARAM;
+    }
+    else if (map->vaddr == 0)
+    {
+        status = shm_map_task(region, map, task);
+    }
+    if (!ERROR(status))
+    {
+        *vaddr = map->vaddr;
+        *pages = region->pages;
+    }
+    spinlock_unlock(&shm_lock);
+    intr_set_status(intr_status);
+    return status;
+}
+
+PUBLIC status_t shm_region_unmap(task_struct_t *task, uint64_t handle)
+{
+    status_t      status      = K_SUCCESS;
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&shm_lock);
+
+    shm_region_t *region = shm_lookup(handle);
+    shm_map_t    *map    = NULL;
+    if (region != NULL)
+    {
+        map = shm_find_map(region, task->pid);
+    }
+    if (map == NULL || map->vaddr == 0)
+    {
+        status = K_INVALID_PARAM;
+    }
+    else
+    {
+        if (region->owner == task->pid)
+        {
+            region->owner = PID_NO_TASK;
+        }
+        shm_unmap_task(region, map, task);
+    }
+    spinlock_unlock(&shm_lock);
+    intr_set_status(intr_status);
+    return status;
+}
+
+PUBLIC status_t shm_region_get(
+    task_struct_t *task,
+    uint64_t       handle,
+    void         **kaddr,
+    size_t        *size
+)
+{
+    status_t      status      = K_SUCCESS;
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&shm_lock);
+
+    shm_region_t *region = shm_lookup(handle);
+    shm_map_t    *map    = NULL;
+    if (region != NULL)
+    {
+        map = shm_find_map(region, task->pid);
+    }
+    if (map == NULL || map->vaddr == 0)
+    {
+        status = K_INVALID_PARAM;
+    }
+    else
+    {
+        // 区域的物理页是连续的,内核通过直接映射访问
+        region->mapped++;
+        *kaddr = PHYS_TO_VIRT(region->paddr);
+        *size  = region->pages * PG_SIZE;
+    }
+    spinlock_unlock(&shm_lock);
+    intr_set_status(intr_status);
+    return status;
+}
+
+PUBLIC void shm_region_put(uint64_t handle)
+{
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&shm_lock);
+    shm_region_t *region = shm_lookup(handle);
+    if (region != NULL)
+    {
+        shm_region_release(region);
+    }
+    spinlock_unlock(&shm_lock);
+    intr_set_status(intr_status);
+    return;
+}
+
+PUBLIC void shm_task_exit(task_struct_t *task)
+{
+    intr_status_t intr_status = intr_disable();
+    spinlock_lock(&shm_lock);
+    int i;
+    for (i = 0; i < SHM_REGIONS; i++)
+    {
+        shm_region_t *region = &shm_regions[i];
+        if (region->pages == 0)
+        {
+            continue;
+        }
+        if (region->owner == task->pid)
+        {
+            region->owner = PID_NO_TASK;
+        }
+        shm_map_t *map = shm_find_map(region, task->pid);
+        if (map == NULL)
+        {
+            continue;
+        }
+        // 先撤销授权,pid被重新分配后不能再映射此区域
+        map->pid = PID_NO_TASK;
+        if (map->vaddr != 0)
+        {
+            shm_unmap_task(region, map, task);
+        }
+    }
+    spinlock_unlock(&shm_lock);
+    intr_set_status(intr_status);
+    return;
+}
@@ -16,12 +16,14 @@ PRIVATE struct
     const char *name;
     size_t      kstack_size;
     void       *func;
+    uint32_t    policy;      // 调度策略
+    uint32_t    rt_priority; // 实时优先级(policy为SCHED_NORMAL时忽略)
 } services[SERVICES] = {
-    { 0, TICK, "TICK", 4096, tick_main },
-    { 1, MM, "MM", 4096, mm_main },
-    { 0, VIEW, "VIEW", 4096, view_main },
-    { 1, USB_SRV, "USB Service", 4096, usb_main },
-    { 1, KBD_SRV, "Keyboard Services", 4096, keyboard_main },
+    { 0, TICK, "TICK", 4096, tick_main, SCHED_FIFO, 3 },
+    { 1, MM, "MM", 4096, mm_main, SCHED_NORMAL, 0 },
+    { 0, VIEW, "VIEW", 4096, view_main, SCHED_NORMAL, 0 },
+    { 1, USB_SRV, "USB Service", 4096, usb_main, SCHED_NORMAL, 0 },
+    { 1, KBD_SRV, "Keyboard Services", 4096, keyboard_main, SCHED_FIFO, 2 },
 };
 
 PRIVATE pid_t service_pid_table[SERVICES] = { PID_NO_TASK };
@@ -40,6 +42,19 @@ PUBLIC pid_t service_id_to_pid(uint32_t sid)
     return PID_NO_TASK;
 }
 
+PUBLIC bool is_service_pid(pid_t pid)
+{
+    int i;
+    for (i = 0; i < SERVICES; i++)
+    {
+        if (service_pid_table[i] == pid)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
 PUBLIC void service_init(void)
 {
     int i;
@@ -58,6 +73,10 @@ PUBLIC void service_init(void)
             task = proc_execute(name, SERVICE_PRIORITY, kstack_size, func);
         }
 
+        // TICK与键盘服务由中断驱动,使用实时调度以免在用户进程负载下被延迟.
+        // USB服务轮询端口事件,使用实时调度会一直占用cpu,因此仍使用CFS
+        task_set_scheduler(task, services[i].policy, services[i].rt_priority);
+
         int index = services[i].service_id - SERVICE_ID_BASE;
 
         service_pid_table[index] = task->pid;
@@ -13,6 +13,9 @@
 #include <std/string.h> // memset
 #include <ulib.h>
 
+// 缓存的共享内存区域映射的数量
+#define VIEW_SHM_CACHE 4
+
 PRIVATE struct
 {
     uint32_t *vram;
@@ -21,6 +24,31 @@ PRIVATE struct
     uint32_t  pixel_per_scanline;
 } gi;
 
+// 已映射的客户端共享内存区域,客户端每帧只发送句柄与偏移
+PRIVATE struct
+{
+    uint64_t handle;
+    uint8_t *addr; // NULL表示空闲
+    size_t   size;
+} shm_cache[VIEW_SHM_CACHE];
+
+PRIVATE int shm_cache_next;
+
+PRIVATE void
+view_draw(uint32_t *buf, uint32_t xsize, uint32_t ysize, uint32_t x, uint32_t y)
+{
+    uint32_t i, j;
+    for (j = 0; j < ysize; j++)
+    {
+        for (i = 0; i < xsize; i++)
+        {
+            uint32_t pixel = *(buf + j * xsize + i);
+            *(gi.vram + (y + j) * gi.pixel_per_scanline + x + i) = pixel;
+        }
+    }
+    return;
+}
+
 PRIVATE void view_fill(message_t *msg)
 {
 
@@ -42,19 +70,102 @@ PRIVATE void view_fill(message_t *msg)
     read_task_addr(msg->src, in_buffer, in_buffer_size, buf);
 
     // print buf to screen.
-    uint32_t x, y;
-    for (y = 0; y < in_ysize; y++)
+    view_draw(buf, in_xsize, in_ysize, in_x, in_y);
+    free_page(buf);
+    return;
+}
+
+/**
+ * @brief 解除客户端已不再使用的区域的映射
+ * @note 创建者解除映射或退出后区域不能再被映射,shm_map失败.
+ *       此时VIEW的映射是区域最后的引用,解除后区域才会被释放
+ */
+PRIVATE void view_shm_sweep(void)
+{
+    int i;
+    for (i = 0; i < VIEW_SHM_CACHE; i++)
     {
-        for (x = 0; x < in_xsize; x++)
+        if (shm_cache[i].addr == NULL)
         {
-            uint32_t pixel = *(buf + y * in_xsize + x);
-            *(gi.vram + (in_y + y) * gi.pixel_per_scanline + in_x + x) = pixel;
+            continue;
+        }
+        if (shm_map(shm_cache[i].handle, NULL) == NULL)
+        {
+            shm_unmap(shm_cache[i].handle);
+            shm_cache[i].addr = NULL;
         }
     }
-    free_page(buf);
     return;
 }
 
+/**
+ * @brief 获取共享内存区域在VIEW中的地址,首次使用时映射
+ * @param handle 区域的句柄(客户端需先授权给VIEW)
+ * @param size 区域的大小
+ * @return 映射失败时返回NULL
+ */
+PRIVATE uint8_t *view_shm_addr(uint64_t handle, size_t *size)
+{
+    int i;
+    for (i = 0; i < VIEW_SHM_CACHE; i++)
+    {
+        if (shm_cache[i].addr != NULL && shm_cache[i].handle == handle)
+        {
+            *size = shm_cache[i].size;
+            return shm_cache[i].addr;
+        }
+    }
+    uint8_t *addr = shm_map(handle, size);
+    if (addr == NULL)
+    {
+        return NULL;
+    }
+    // 使用空闲的项,没有时替换最早映射的区域
+    for (i = 0; i < VIEW_SHM_CACHE; i++)
+    {
+        if (shm_cache[i].addr == NULL)
+        {
+            break;
+        }
+    }
+    if (i == VIEW_SHM_CACHE)
+    {
+        i = shm_cache_next;
+        shm_unmap(shm_cache[i].handle);
+    }
+    shm_cache[i].handle = handle;
+    shm_cache[i].addr   = addr;
+    shm_cache[i].size   = *size;
+    shm_cache_next      = (i + 1) % VIEW_SHM_CACHE;
+    return addr;
+}
+
+PRIVATE syscall_status_t view_fill_shm(message_t *msg)
+{
+    uint64_t in_handle = msg->m[IN_VIEW_FILL_SHM_HANDLE];
+    size_t   in_offset = (size_t)msg->m[IN_VIEW_FILL_SHM_OFFSET];
+    uint32_t in_xsize  = (uint32_t)msg->m[IN_VIEW_FILL_SHM_XSIZE];
+    uint32_t in_ysize  = (uint32_t)msg->m[IN_VIEW_FILL_SHM_YSIZE];
+    uint32_t in_x      = (uint32_t)msg->m[IN_VIEW_FILL_SHM_X];
+    uint32_t in_y      = (uint32_t)msg->m[IN_VIEW_FILL_SHM_Y];
+
+    view_shm_sweep();
+
+    size_t   size;
+    uint8_t *addr = view_shm_addr(in_handle, &size);
+    if (addr == NULL)
+    {
+        return SYSCALL_ERROR;
+    }
+    size_t bytes = (size_t)in_xsize * in_ysize * sizeof(uint32_t);
+    if (in_offset > size || bytes > size - in_offset)
+    {
+        return SYSCALL_ERROR;
+    }
+    view_draw((uint32_t *)(addr + in_offset), in_xsize, in_ysize, in_x, in_y);
+    return SYSCALL_SUCCESS;
+}
+
 PUBLIC void view_main()
 {
     graph_info_t *g_graph_info = &BOOT_INFO->graph_info;
@@ -73,6 +184,10 @@ PUBLIC void view_main()
                 view_fill(&msg);
                 send_recv(NR_SEND, msg.src, &msg);
                 break;
+            case VIEW_FILL_SHM:
+                msg.m[OUT_VIEW_FILL_SHM_STATUS] = view_fill_shm(&msg);
+                send_recv(NR_SEND, msg.src, &msg);
+                break;
             default:
                 break;
         }
@@ -1,9 +1,12 @@
 SRC += $(SRC_DIR)/kernel/main.c
 SRC += $(SRC_DIR)/kernel/symbols.c
 SRC += $(SRC_DIR)/kernel/config.c
+SRC += $(SRC_DIR)/kernel/bench.c
 SRC += $(SRC_DIR)/kernel/service/kernel.c
 SRC += $(SRC_DIR)/kernel/service/kern_task.c
 SRC += $(SRC_DIR)/kernel/service/kern_mem.c
+SRC += $(SRC_DIR)/kernel/service/kern_sched.c
+SRC += $(SRC_DIR)/kernel/service/kern_ring.c
 
 SRC += $(SRC_DIR)/softirq/softirq.c
 SRC += $(SRC_DIR)/service/service.c
@@ -13,11 +16,13 @@ SRC += $(SRC_DIR)/service/view/view.c
 SRC += $(SRC_DIR)/mem/allocator.c
 SRC += $(SRC_DIR)/mem/service/mm.c
 SRC += $(SRC_DIR)/mem/vmm.c
+SRC += $(SRC_DIR)/mem/shm.c
 
 SRC += $(SRC_DIR)/ramfs/ramfs.c
 SRC += $(SRC_DIR)/sync/semaphore.c
 SRC += $(SRC_DIR)/lib/bitmap.c
 SRC += $(SRC_DIR)/lib/list.c
+SRC += $(SRC_DIR)/lib/rbtree.c
 SRC += $(SRC_DIR)/lib/fifo.c
 SRC += $(SRC_DIR)/lib/stdio.c
 SRC += $(SRC_DIR)/lib/string.c
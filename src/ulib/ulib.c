@@ -18,20 +18,18 @@ PUBLIC void exit(int status)
 
 PUBLIC int get_pid(void)
 {
-    message_t msg;
-    memset(&msg, 0, sizeof(msg));
-    msg.type = KERN_GET_PID;
-    send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
-    return (pid_t)msg.m[OUT_KERN_GET_PID_PID];
+    uint64_t out[REG_MESSAGE_WORDS] = { 0 };
+    send_recv_reg(NR_SEND, SEND_TO_KERNEL, KERN_GET_PID, 0, 0, 0, 0, 0, 0, out);
+    return (pid_t)out[OUT_KERN_GET_PID_PID];
 }
 
 PUBLIC int get_ppid(void)
 {
-    message_t msg;
-    memset(&msg, 0, sizeof(msg));
-    msg.type = KERN_GET_PPID;
-    send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
-    return (pid_t)msg.m[OUT_KERN_GET_PPID_PPID];
+    uint64_t out[REG_MESSAGE_WORDS] = { 0 };
+    send_recv_reg(
+        NR_SEND, SEND_TO_KERNEL, KERN_GET_PPID, 0, 0, 0, 0, 0, 0, out
+    );
+    return (pid_t)out[OUT_KERN_GET_PPID_PPID];
 }
 
 PUBLIC int create_process(const char *name, void *proc)
@@ -59,25 +57,32 @@ PUBLIC pid_t waitpid(pid_t pid, int *status, int options)
 
 PUBLIC void *allocate_page(void)
 {
-    message_t msg;
-    memset(&msg, 0, sizeof(msg));
-    msg.type = KERN_ALLOCATE_PAGE;
+    uint64_t         out[REG_MESSAGE_WORDS];
     syscall_status_t status;
-    status = send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    status = send_recv_reg(
+        NR_SEND, SEND_TO_KERNEL, KERN_ALLOCATE_PAGE, 0, 0, 0, 0, 0, 0, out
+    );
     if (status != SYSCALL_SUCCESS)
     {
         return NULL;
     }
-    return (void *)msg.m[OUT_KERN_ALLOCATE_PAGE_ADDR];
+    return (void *)out[OUT_KERN_ALLOCATE_PAGE_ADDR];
 }
 
 PUBLIC void free_page(void *addr)
 {
-    message_t msg;
-    memset(&msg, 0, sizeof(msg));
-    msg.type                      = KERN_FREE_PAGE;
-    msg.m[IN_KERN_FREE_PAGE_ADDR] = (uint64_t)addr;
-    send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    send_recv_reg(
+        NR_SEND,
+        SEND_TO_KERNEL,
+        KERN_FREE_PAGE,
+        (uint64_t)addr,
+        0,
+        0,
+        0,
+        0,
+        0,
+        NULL
+    );
     return;
 }
 
@@ -94,13 +99,295 @@ PUBLIC void read_task_addr(pid_t pid, void *addr, size_t size, void *buffer)
     return;
 }
 
-PUBLIC uint64_t get_ticks(void)
+PUBLIC int set_scheduler(pid_t pid, uint32_t policy, uint32_t rt_priority)
+{
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type                             = KERN_SET_SCHED;
+    msg.m[IN_KERN_SET_SCHED_PID]         = pid;
+    msg.m[IN_KERN_SET_SCHED_POLICY]      = policy;
+    msg.m[IN_KERN_SET_SCHED_RT_PRIORITY] = rt_priority;
+    syscall_status_t status;
+    status = send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+PUBLIC int set_sched_slice(pid_t pid, uint64_t slice)
+{
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type                       = KERN_SET_SLICE;
+    msg.m[IN_KERN_SET_SLICE_PID]   = pid;
+    msg.m[IN_KERN_SET_SLICE_SLICE] = slice;
+    syscall_status_t status;
+    status = send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+PUBLIC int set_affinity(pid_t pid, const uint64_t *mask)
+{
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type                        = KERN_SET_AFFINITY;
+    msg.m[IN_KERN_SET_AFFINITY_PID] = pid;
+    memcpy(
+        &msg.m[IN_KERN_SET_AFFINITY_MASK],
+        mask,
+        AFFINITY_MASK_WORDS * sizeof(uint64_t)
+    );
+    syscall_status_t status;
+    status = send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+PUBLIC int get_affinity(pid_t pid, uint64_t *mask)
 {
     message_t msg;
     memset(&msg, 0, sizeof(msg));
-    msg.type = TICK_GET_TICKS;
-    send_recv(NR_BOTH, TICK, &msg);
-    return msg.m[OUT_TICK_GET_TICKS_TICKS];
+    msg.type                        = KERN_GET_AFFINITY;
+    msg.m[IN_KERN_GET_AFFINITY_PID] = pid;
+    syscall_status_t status;
+    status = send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    memcpy(
+        mask,
+        &msg.m[OUT_KERN_GET_AFFINITY_MASK],
+        AFFINITY_MASK_WORDS * sizeof(uint64_t)
+    );
+    return 0;
+}
+
+PUBLIC int create_sched_group(uint64_t weight)
+{
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type                           = KERN_CREATE_GROUP;
+    msg.m[IN_KERN_CREATE_GROUP_WEIGHT] = weight;
+    syscall_status_t status;
+    status = send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return (int)msg.m[OUT_KERN_CREATE_GROUP_ID];
+}
+
+PUBLIC int set_sched_group(pid_t pid, uint32_t id)
+{
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type                     = KERN_SET_GROUP;
+    msg.m[IN_KERN_SET_GROUP_PID] = pid;
+    msg.m[IN_KERN_SET_GROUP_ID]  = id;
+    syscall_status_t status;
+    status = send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+PUBLIC int
+set_deadline(pid_t pid, uint64_t runtime, uint64_t deadline, uint64_t period)
+{
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type                             = KERN_SET_DEADLINE;
+    msg.m[IN_KERN_SET_DEADLINE_PID]      = pid;
+    msg.m[IN_KERN_SET_DEADLINE_RUNTIME]  = runtime;
+    msg.m[IN_KERN_SET_DEADLINE_DEADLINE] = deadline;
+    msg.m[IN_KERN_SET_DEADLINE_PERIOD]   = period;
+    syscall_status_t status;
+    status = send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+PUBLIC int get_task_stat(pid_t pid, task_sched_stat_t *stat)
+{
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type                            = KERN_GET_TASK_STAT;
+    msg.m[IN_KERN_GET_TASK_STAT_PID]    = pid;
+    msg.m[IN_KERN_GET_TASK_STAT_BUFFER] = (uint64_t)stat;
+    syscall_status_t status;
+    status = send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+PUBLIC int get_cpu_stat(uint32_t cpu_id, cpu_sched_stat_t *stat)
+{
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type                           = KERN_GET_CPU_STAT;
+    msg.m[IN_KERN_GET_CPU_STAT_CPU]    = cpu_id;
+    msg.m[IN_KERN_GET_CPU_STAT_BUFFER] = (uint64_t)stat;
+    syscall_status_t status;
+    status = send_recv(NR_SEND, SEND_TO_KERNEL, &msg);
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+PUBLIC void *shm_create(size_t size, uint64_t *handle)
+{
+    uint64_t         out[REG_MESSAGE_WORDS];
+    syscall_status_t status;
+    status = send_recv_reg(
+        NR_SEND, SEND_TO_KERNEL, KERN_SHM_CREATE, size, 0, 0, 0, 0, 0, out
+    );
+    if (status != SYSCALL_SUCCESS)
+    {
+        return NULL;
+    }
+    *handle = out[OUT_KERN_SHM_CREATE_HANDLE];
+    return (void *)out[OUT_KERN_SHM_CREATE_ADDR];
+}
+
+PUBLIC int shm_grant(uint64_t handle, pid_t pid)
+{
+    syscall_status_t status;
+    status = send_recv_reg(
+        NR_SEND, SEND_TO_KERNEL, KERN_SHM_GRANT, handle, pid, 0, 0, 0, 0, NULL
+    );
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+PUBLIC void *shm_map(uint64_t handle, size_t *size)
+{
+    uint64_t         out[REG_MESSAGE_WORDS];
+    syscall_status_t status;
+    status = send_recv_reg(
+        NR_SEND, SEND_TO_KERNEL, KERN_SHM_MAP, handle, 0, 0, 0, 0, 0, out
+    );
+    if (status != SYSCALL_SUCCESS)
+    {
+        return NULL;
+    }
+    if (size != NULL)
+    {
+        *size = out[OUT_KERN_SHM_MAP_SIZE];
+    }
+    return (void *)out[OUT_KERN_SHM_MAP_ADDR];
+}
+
+PUBLIC int shm_unmap(uint64_t handle)
+{
+    syscall_status_t status;
+    status = send_recv_reg(
+        NR_SEND, SEND_TO_KERNEL, KERN_SHM_UNMAP, handle, 0, 0, 0, 0, 0, NULL
+    );
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+PUBLIC int ring_setup(uint64_t handle, uint64_t entries, uint64_t flags)
+{
+    syscall_status_t status;
+    status = send_recv_reg(
+        NR_SEND,
+        SEND_TO_KERNEL,
+        KERN_RING_SETUP,
+        handle,
+        entries,
+        flags,
+        0,
+        0,
+        0,
+        NULL
+    );
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+PUBLIC int ring_enter(void)
+{
+    uint64_t         out[REG_MESSAGE_WORDS];
+    syscall_status_t status;
+    status = send_recv_reg(
+        NR_SEND, SEND_TO_KERNEL, KERN_RING_ENTER, 0, 0, 0, 0, 0, 0, out
+    );
+    if (status != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return (int)out[OUT_KERN_RING_ENTER_DONE];
+}
+
+PUBLIC int ring_submit(
+    kernel_ring_t   *ring,
+    uint64_t         entries,
+    uint64_t         user_data,
+    const message_t *msg
+)
+{
+    uint64_t sq_tail = atomic_read(&ring->sq_tail);
+    if (sq_tail - atomic_read(&ring->sq_head) >= entries)
+    {
+        return -1;
+    }
+    ring_sqe_t *sqe = &RING_SQES(ring)[sq_tail & (entries - 1)];
+    sqe->user_data  = user_data;
+    memcpy(&sqe->msg, msg, sizeof(*msg));
+    // 提交项写入后才更新sq_tail,atomic_set带有内存屏障,
+    // 之后读取的flags已反映轮询任务是否需要唤醒
+    atomic_set(&ring->sq_tail, sq_tail + 1);
+    return 0;
+}
+
+PUBLIC int ring_reap(kernel_ring_t *ring, uint64_t entries, ring_cqe_t *cqe)
+{
+    uint64_t cq_head = atomic_read(&ring->cq_head);
+    if (cq_head == atomic_read(&ring->cq_tail))
+    {
+        return -1;
+    }
+    ring_cqe_t *src = &RING_CQES(ring, entries)[cq_head & (entries - 1)];
+    memcpy(cqe, src, sizeof(*cqe));
+    atomic_set(&ring->cq_head, cq_head + 1);
+    return 0;
+}
+
+PUBLIC uint64_t get_ticks(void)
+{
+    uint64_t out[REG_MESSAGE_WORDS] = { 0 };
+    send_recv_reg(NR_BOTH, TICK, TICK_GET_TICKS, 0, 0, 0, 0, 0, 0, out);
+    return out[OUT_TICK_GET_TICKS_TICKS];
 }
 
 PUBLIC void fill(
@@ -124,4 +411,26 @@ PUBLIC void fill(
     msg.m[IN_VIEW_FILL_Y] = y;
     send_recv(NR_BOTH, VIEW, &msg);
     return;
-}
\ No newline at end of file
+}
+
+PUBLIC int fill_shm(
+    uint64_t handle,
+    size_t   offset,
+    uint32_t xsize,
+    uint32_t ysize,
+    uint32_t x,
+    uint32_t y
+)
+{
+    uint64_t         out[REG_MESSAGE_WORDS];
+    syscall_status_t status;
+    status = send_recv_reg(
+        NR_BOTH, VIEW, VIEW_FILL_SHM, handle, offset, xsize, ysize, x, y, out
+    );
+    if (status != SYSCALL_SUCCESS ||
+        out[OUT_VIEW_FILL_SHM_STATUS] != SYSCALL_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}